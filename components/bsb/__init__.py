@@ -1,12 +1,20 @@
 import re
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.components import uart
+from esphome.components import sensor, uart, web_server_base
+from esphome.components.web_server_base import CONF_WEB_SERVER_BASE_ID
 from esphome.const import (
     CONF_ID,
-    CONF_TRIGGER_ID
+    CONF_OPTIMISTIC,
+    CONF_TRIGGER_ID,
+    CONF_UPDATE_INTERVAL,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MILLISECOND
 )
 from esphome import automation
+from esphome.core import CORE
 
 CODEOWNERS = ["@eringerli"]
 MULTI_CONF = True
@@ -18,9 +26,33 @@ CONF_PARAMETER_NUMBER = "parameter_number"
 CONF_SOURCE_ADDRESS = "source_address"
 CONF_DESTINATION_ADDRESS = "destination_address"
 CONF_QUERY_INTERVAL = "query_interval"
+CONF_REQUEST_TIMEOUT = "request_timeout"
+CONF_BUS_IDLE_BYTES = "bus_idle_bytes"
+CONF_BUS_BACKOFF_BYTES = "bus_backoff_bytes"
+CONF_PASSIVE_REFRESH = "passive_refresh"
+CONF_PASSIVE_STALENESS = "passive_staleness"
 CONF_RETRY_INTERVAL = "retry_interval"
 CONF_RETRY_COUNT = "retry_count"
 CONF_BSB_TYPE= "type"
+CONF_CRC_TABLE = "crc_table"
+CONF_TRACE_SIZE = "trace_size"
+CONF_CAPTURE_ENDPOINT = "capture_endpoint"
+CONF_METRICS = "metrics"
+CONF_RECEIVE_TASK = "receive_task"
+CONF_VALUE_CACHE_INTERVAL = "value_cache_interval"
+CONF_DEADBAND = "deadband"
+CONF_RELATIVE_DEADBAND = "relative_deadband"
+CONF_MIN_PUBLISH_INTERVAL = "min_publish_interval"
+CONF_HEARTBEAT = "heartbeat"
+CONF_MIN_UPDATE_INTERVAL = "min_update_interval"
+CONF_MAX_UPDATE_INTERVAL = "max_update_interval"
+CONF_OPTIONS_ID = "options_id"
+CONF_OPTIONS_INDEX_ID = "options_index_id"
+
+CONF_CRC_TABLE_ENUM = {
+    "SMALL":0,
+    "LARGE":1
+}
 
 CONF_BSB_TYPE_ENUM = {
     "UINT8":0,
@@ -37,6 +69,9 @@ BsbComponent = bsb_ns.class_(
     "BsbComponent", cg.Component, uart.UARTDevice
 )
 
+BsbMetric = bsb_ns.enum("BsbMetric", is_class=True)
+BsbOption = bsb_ns.struct("BsbOption")
+
 BsbTimeoutTrigger = bsb_ns.class_(
     "BsbTimeoutTrigger", automation.Trigger
 )
@@ -44,6 +79,101 @@ BsbWaitNextReadoutTrigger = bsb_ns.class_(
     "BsbWaitNextReadoutTrigger", automation.Trigger
 )
 
+# when decoded values are published, for all entities
+PUBLISH_FILTER_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_MIN_PUBLISH_INTERVAL): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_HEARTBEAT): cv.positive_time_period_milliseconds,
+    }
+)
+
+# numeric entities can also ignore small changes
+DEADBAND_SCHEMA = PUBLISH_FILTER_SCHEMA.extend(
+    {
+        cv.Optional(CONF_DEADBAND): cv.positive_float,
+        cv.Optional(CONF_RELATIVE_DEADBAND): cv.percentage,
+    }
+)
+
+
+# writable entities confirm a Set by reading the value back after the Ack, optimistic ones take the Ack for it
+WRITE_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_OPTIMISTIC, default=False): cv.boolean,
+    }
+)
+
+
+async def setup_write(var, config):
+    cg.add(var.set_optimistic(config[CONF_OPTIMISTIC]))
+
+
+async def setup_publish_filter(var, config):
+    if CONF_DEADBAND in config:
+        cg.add(var.set_deadband(config[CONF_DEADBAND]))
+
+    if CONF_RELATIVE_DEADBAND in config:
+        cg.add(var.set_relative_deadband(config[CONF_RELATIVE_DEADBAND]))
+
+    if CONF_MIN_PUBLISH_INTERVAL in config:
+        cg.add(var.set_min_publish_interval(config[CONF_MIN_PUBLISH_INTERVAL]))
+
+    if CONF_HEARTBEAT in config:
+        cg.add(var.set_heartbeat(config[CONF_HEARTBEAT]))
+
+
+# polling that follows how much a value moves, for all entities
+ADAPTIVE_POLLING_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_MIN_UPDATE_INTERVAL): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_MAX_UPDATE_INTERVAL): cv.positive_time_period_milliseconds,
+    }
+)
+
+
+def validate_adaptive_polling(config):
+    if (CONF_MIN_UPDATE_INTERVAL in config) != (CONF_MAX_UPDATE_INTERVAL in config):
+        raise cv.Invalid(f"{CONF_MIN_UPDATE_INTERVAL} and {CONF_MAX_UPDATE_INTERVAL} have to be set together")
+    if CONF_MIN_UPDATE_INTERVAL in config and config[CONF_MIN_UPDATE_INTERVAL] >= config[CONF_MAX_UPDATE_INTERVAL]:
+        raise cv.Invalid(f"{CONF_MIN_UPDATE_INTERVAL} has to be shorter than {CONF_MAX_UPDATE_INTERVAL}")
+
+    return config
+
+
+async def setup_adaptive_polling(var, config):
+    if CONF_MIN_UPDATE_INTERVAL in config:
+        cg.add(var.set_min_update_interval(config[CONF_MIN_UPDATE_INTERVAL]))
+
+    if CONF_MAX_UPDATE_INTERVAL in config:
+        cg.add(var.set_max_update_interval(config[CONF_MAX_UPDATE_INTERVAL]))
+
+
+# the ids of the constant option tables of enum entities
+OPTIONS_TABLE_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_OPTIONS_ID): cv.declare_id(BsbOption),
+        cv.GenerateID(CONF_OPTIONS_INDEX_ID): cv.declare_id(cg.uint8),
+    }
+)
+
+
+def option_table(config, options, index=True):
+    """Emits the options as constant arrays (see BsbOptionTable): sorted by value, and their indices sorted by text in
+    strcmp order. Returns the arrays and their size."""
+    # values are int8_t on the bus, 255 is -1
+    entries = sorted((((value + 128) % 256) - 128, option) for value, option in options.items())
+    table = cg.static_const_array(
+        config[CONF_OPTIONS_ID],
+        cg.ArrayInitializer(*[cg.ArrayInitializer(value, option) for value, option in entries], multiline=True),
+    )
+    if not index:
+        return table, None, len(entries)
+
+    by_option = sorted(range(len(entries)), key=lambda i: entries[i][1].encode("utf-8"))
+    by_option_table = cg.static_const_array(config[CONF_OPTIONS_INDEX_ID], cg.ArrayInitializer(*by_option))
+    return table, by_option_table, len(entries)
+
+
 def validate_baud_rate(value):
     if value > 0:
         baud_rates = [ 4800 ]
@@ -53,23 +183,103 @@ def validate_baud_rate(value):
     return value
 
 
+def metric_schema(unit, icon, state_class, accuracy_decimals=0):
+    return sensor.sensor_schema(
+        unit_of_measurement=unit,
+        icon=icon,
+        accuracy_decimals=accuracy_decimals,
+        state_class=state_class,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    )
+
+
+# key in the metrics block: (BsbMetric, sensor schema)
+METRICS = {
+    "bytes_received": ("BytesIn", metric_schema("B", "mdi:download", STATE_CLASS_TOTAL_INCREASING)),
+    "bytes_sent": ("BytesOut", metric_schema("B", "mdi:upload", STATE_CLASS_TOTAL_INCREASING)),
+    "frames_per_second": ("FramesPerSecond", metric_schema("frames/s", "mdi:swap-horizontal", STATE_CLASS_MEASUREMENT, 2)),
+    "crc_errors": ("CrcErrors", metric_schema(None, "mdi:alert-circle-outline", STATE_CLASS_TOTAL_INCREASING)),
+    "framing_errors": ("FramingErrors", metric_schema(None, "mdi:alert-circle-outline", STATE_CLASS_TOTAL_INCREASING)),
+    "latency_p50": ("LatencyP50", metric_schema(UNIT_MILLISECOND, "mdi:timer-outline", STATE_CLASS_MEASUREMENT)),
+    "latency_p90": ("LatencyP90", metric_schema(UNIT_MILLISECOND, "mdi:timer-outline", STATE_CLASS_MEASUREMENT)),
+    "latency_p99": ("LatencyP99", metric_schema(UNIT_MILLISECOND, "mdi:timer-outline", STATE_CLASS_MEASUREMENT)),
+    "retries": ("Retries", metric_schema(None, "mdi:refresh", STATE_CLASS_TOTAL_INCREASING)),
+    "retries_exhausted": ("RetriesExhausted", metric_schema(None, "mdi:refresh-auto", STATE_CLASS_TOTAL_INCREASING)),
+    "nacks": ("Nacks", metric_schema(None, "mdi:close-circle-outline", STATE_CLASS_TOTAL_INCREASING)),
+    "timeouts": ("Timeouts", metric_schema(None, "mdi:timer-alert-outline", STATE_CLASS_TOTAL_INCREASING)),
+    "scheduler_lag_p90": ("SchedulerLagP90", metric_schema(UNIT_MILLISECOND, "mdi:timer-sand", STATE_CLASS_MEASUREMENT)),
+    "scheduler_lag_max": ("SchedulerLagMax", metric_schema(UNIT_MILLISECOND, "mdi:timer-sand", STATE_CLASS_MEASUREMENT)),
+    "scheduler_overrun": ("SchedulerOverrun", metric_schema(UNIT_MILLISECOND, "mdi:timer-alert-outline", STATE_CLASS_MEASUREMENT)),
+    "frames_dropped": ("FramesDropped", metric_schema(None, "mdi:alert-circle-outline", STATE_CLASS_TOTAL_INCREASING)),
+    "stale_values": ("StaleValues", metric_schema(None, "mdi:history", STATE_CLASS_MEASUREMENT)),
+}
+
+METRICS_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_UPDATE_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+        **{cv.Optional(key): schema for key, (_, schema) in METRICS.items()},
+    }
+)
+
+
+CAPTURE_MAX_TRACE_SIZE_ESP8266 = 256
+
+
+def validate_capture_endpoint(config):
+    if config[CONF_CAPTURE_ENDPOINT]:
+        if CONF_WEB_SERVER_BASE_ID not in config:
+            raise cv.Invalid(f"{CONF_CAPTURE_ENDPOINT} needs the web_server component")
+        if config[CONF_TRACE_SIZE] == 0:
+            raise cv.Invalid(f"{CONF_CAPTURE_ENDPOINT} needs {CONF_TRACE_SIZE} > 0")
+        # each download holds the file in the heap until it is sent, up to 50 bytes per frame
+        if CORE.is_esp8266 and config[CONF_TRACE_SIZE] > CAPTURE_MAX_TRACE_SIZE_ESP8266:
+            raise cv.Invalid(
+                f"{CONF_CAPTURE_ENDPOINT} needs {CONF_TRACE_SIZE} <= {CAPTURE_MAX_TRACE_SIZE_ESP8266} on the ESP8266"
+            )
+
+    return config
+
+
+def validate_receive_task(config):
+    if config[CONF_RECEIVE_TASK] and not CORE.is_esp32:
+        raise cv.Invalid(f"{CONF_RECEIVE_TASK} needs an ESP32")
+
+    return config
+
+
 CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(BsbComponent),
             cv.Optional(CONF_RETRY_COUNT, default="3"): cv.hex_int_range(0x00,0xff),
             cv.Optional(CONF_RETRY_INTERVAL, default="15s"): cv.positive_time_period_milliseconds,
-            cv.Optional(CONF_QUERY_INTERVAL, default="0.25s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_QUERY_INTERVAL, default="0.05s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_REQUEST_TIMEOUT, default="0.5s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_BUS_IDLE_BYTES, default=3): cv.int_range(min=0, max=32),
+            cv.Optional(CONF_BUS_BACKOFF_BYTES, default=4): cv.int_range(min=0, max=32),
+            cv.Optional(CONF_PASSIVE_REFRESH, default=False): cv.boolean,
+            cv.Optional(CONF_PASSIVE_STALENESS, default=1.5): cv.float_range(min=1.0),
             cv.Optional(
                 CONF_SOURCE_ADDRESS, default="66"
             ): cv.positive_int,
             cv.Optional(
                 CONF_DESTINATION_ADDRESS, default="0"
             ): cv.positive_int,
+            cv.Optional(CONF_CRC_TABLE, default="LARGE"): cv.enum(CONF_CRC_TABLE_ENUM, upper=True),
+            cv.Optional(CONF_TRACE_SIZE, default=32): cv.one_of(0, 8, 16, 32, 64, 128, 256, 512, 1024, int=True),
+            cv.Optional(CONF_CAPTURE_ENDPOINT, default=False): cv.boolean,
+            cv.Optional(CONF_METRICS): METRICS_SCHEMA,
+            cv.Optional(CONF_RECEIVE_TASK, default=False): cv.boolean,
+            cv.Optional(CONF_VALUE_CACHE_INTERVAL): cv.positive_time_period_milliseconds,
+            cv.OnlyWith(CONF_WEB_SERVER_BASE_ID, "web_server_base"): cv.use_id(
+                web_server_base.WebServerBase
+            ),
         }
     )
     .extend(cv.COMPONENT_SCHEMA)
-    .extend(uart.UART_DEVICE_SCHEMA)
+    .extend(uart.UART_DEVICE_SCHEMA),
+    validate_capture_endpoint,
+    validate_receive_task,
 )
 
 
@@ -81,6 +291,21 @@ async def to_code(config):
     if CONF_QUERY_INTERVAL in config:
         cg.add(var.set_query_interval(config[CONF_QUERY_INTERVAL]))
 
+    if CONF_REQUEST_TIMEOUT in config:
+        cg.add(var.set_request_timeout(config[CONF_REQUEST_TIMEOUT]))
+
+    if CONF_BUS_IDLE_BYTES in config:
+        cg.add(var.set_bus_idle_bytes(config[CONF_BUS_IDLE_BYTES]))
+
+    if CONF_BUS_BACKOFF_BYTES in config:
+        cg.add(var.set_bus_backoff_bytes(config[CONF_BUS_BACKOFF_BYTES]))
+
+    if CONF_PASSIVE_REFRESH in config:
+        cg.add(var.set_passive_refresh(config[CONF_PASSIVE_REFRESH]))
+
+    if CONF_PASSIVE_STALENESS in config:
+        cg.add(var.set_passive_staleness(config[CONF_PASSIVE_STALENESS]))
+
     if CONF_RETRY_INTERVAL in config:
         cg.add(var.set_retry_interval(config[CONF_RETRY_INTERVAL]))
 
@@ -92,3 +317,30 @@ async def to_code(config):
 
     if CONF_DESTINATION_ADDRESS in config:
         cg.add(var.set_destination_address(config[CONF_DESTINATION_ADDRESS]))
+
+    if config[CONF_CRC_TABLE] == "SMALL":
+        cg.add_define("BSB_CRC_TABLE_SMALL")
+
+    if config[CONF_TRACE_SIZE] > 0:
+        cg.add_define("BSB_TRACE_SIZE", config[CONF_TRACE_SIZE])
+
+    if config[CONF_CAPTURE_ENDPOINT]:
+        base = await cg.get_variable(config[CONF_WEB_SERVER_BASE_ID])
+        cg.add(var.set_web_server(base))
+        cg.add_define("USE_BSB_CAPTURE_ENDPOINT")
+
+    if config[CONF_RECEIVE_TASK]:
+        cg.add_define("USE_BSB_RECEIVE_TASK")
+        cg.add(var.set_receive_task(True))
+
+    if CONF_VALUE_CACHE_INTERVAL in config:
+        cg.add_define("USE_BSB_VALUE_CACHE")
+        cg.add(var.set_value_cache_interval(config[CONF_VALUE_CACHE_INTERVAL]))
+
+    if CONF_METRICS in config:
+        metrics = config[CONF_METRICS]
+        cg.add(var.set_metrics_interval(metrics[CONF_UPDATE_INTERVAL]))
+        for key, (metric, _) in METRICS.items():
+            if key in metrics:
+                sens = await sensor.new_sensor(metrics[key])
+                cg.add(var.set_metric_sensor(getattr(BsbMetric, metric), sens))
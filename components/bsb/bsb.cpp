@@ -5,8 +5,13 @@
 #include "bsbPacketSend.h"
 #include "bsbSelect.h"
 #include "bsbSensor.h"
+#include "bsbTimeProgram.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/log.h"
+#ifdef USE_LOGGER
+  #include "esphome/components/logger/logger.h"
+#endif
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
@@ -15,20 +20,185 @@ namespace esphome {
 
     const char* const TAG = "bsb.component";
 
-    BsbComponent::BsbComponent() {}
+    BsbComponent::BsbComponent() {
+      bsbPacketReceive.set_crc_error_callback( [this]( const BsbPacket* packet ) { callback_crc_error( packet, micros() ); } );
+    }
+
+    // formatting a packet is far more expensive than receiving it, so the packet log is only built if it gets printed
+    static bool packet_log_enabled() {
+#if defined( USE_LOGGER ) && ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_DEBUG
+      return logger::global_logger != nullptr && logger::global_logger->level_for( TAG ) >= ESPHOME_LOG_LEVEL_DEBUG;
+#else
+      return false;
+#endif
+    }
+
+    void BsbComponent::setup() {
+      ESP_LOGCONFIG( TAG, "Setting up BSB component..." );
+
+      // all entities are registered by now; entities of one field keep the order they were configured in
+      std::stable_sort( entities_.begin(), entities_.end(), []( const BsbDispatchEntry& a, const BsbDispatchEntry& b ) {
+        return a.field_id < b.field_id;
+      } );
+      entities_.shrink_to_fit();
+
+      for( const auto& entry : entities_ ) {
+        entry.entity->select_decoder();
+      }
+
+      plan_polls();
+
+#ifdef USE_BSB_VALUE_CACHE
+      if( value_cache_interval_ != 0 ) {
+        restore_values();
+      }
+#endif
+
+#ifdef USE_BSB_RECEIVE_TASK
+      if( use_receive_task_ ) {
+        receive_task_.reset( new BsbReceiveTask( this ) );
+        receive_task_->start();
+      }
+#endif
+
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+      if( base_ != nullptr ) {
+        base_->init();
+        base_->add_handler( new BsbCaptureHandler< BSB_TRACE_SIZE >( &trace_ ) );
+      }
+#endif
+    }
+
+    std::pair< const BsbDispatchEntry*, const BsbDispatchEntry* > BsbComponent::find_entities( const uint32_t field_id ) const {
+      const BsbDispatchEntry* first = entities_.data();
+      const BsbDispatchEntry* end   = first + entities_.size();
+
+      // branch-free lower bound: halve the range, the comparison only decides by how much first moves
+      size_t count = entities_.size();
+      while( count > 1 ) {
+        const size_t half = count / 2;
+        first += ( first[half].field_id < field_id ) ? half : 0;
+        count -= half;
+      }
+      if( count == 1 && first->field_id < field_id ) {
+        ++first;
+      }
+
+      const BsbDispatchEntry* last = first;
+      while( last != end && last->field_id == field_id ) {
+        ++last;
+      }
+      return { first, last };
+    }
+
+    BsbEntity* BsbComponent::find_poller( const uint32_t field_id ) const {
+      auto range = find_entities( field_id );
+      for( auto entry = range.first; entry != range.second; ++entry ) {
+        if( entry->entity->is_polled() ) {
+          return entry->entity;
+        }
+      }
+      return nullptr;
+    }
+
+    // Entities sharing a field ID would all poll it although one answer updates all of them. Per field ID only the polled
+    // entity with the shortest update interval keeps polling, the others are updated by its answers.
+    void BsbComponent::plan_polls() {
+      for( auto first = entities_.cbegin(); first != entities_.cend(); ) {
+        auto last = first;
+
+        BsbEntity* poller = nullptr;
+        for( ; last != entities_.cend() && last->field_id == first->field_id; ++last ) {
+          BsbEntity* entity = last->entity;
+          if( !entity->is_polled() ) {
+            continue;
+          }
+
+          if( poller == nullptr ) {
+            poller = entity;
+          } else if( entity->get_update_interval() < poller->get_update_interval() ) {
+            poller->set_polled( false );
+            poller = entity;
+          } else {
+            entity->set_polled( false );
+          }
+        }
+
+        first = last;
+      }
+    }
+
+#ifdef USE_BSB_VALUE_CACHE
+    // the cached values are published like broadcasts, the entities count as stale until they are read again
+    void BsbComponent::restore_values() {
+      for( const auto& entry : entities_ ) {
+        value_cache_.add_field( entry.field_id );
+      }
+      value_cache_.setup( destination_address_ );
+
+      BsbPacket packet;
+      uint16_t  restored = 0;
+      for( const auto& entry : entities_ ) {
+        if( value_cache_.restore( entry.field_id, destination_address_, packet ) ) {
+          entry.entity->restore( &packet );
+          ++restored;
+        }
+      }
+      ESP_LOGI( TAG, "Restored %u cached values of %u fields", restored, ( unsigned )value_cache_.size() );
+    }
+
+    void BsbComponent::save_values( const uint32_t now ) {
+      last_value_cache_save_ = now;
+      const uint16_t saved   = value_cache_.save();
+      if( saved != 0 ) {
+        ESP_LOGD( TAG, "Saved %u changed values", saved );
+      }
+    }
+#endif
+
+    uint16_t BsbComponent::count_stale_values() const {
+      // time programs are counted once, by their entry of Monday
+      return ( uint16_t )std::count_if( entities_.cbegin(), entities_.cend(), []( const BsbDispatchEntry& entry ) {
+        return entry.entity->is_stale() && entry.field_id == entry.entity->get_field_id();
+      } );
+    }
 
-    void BsbComponent::setup() { ESP_LOGCONFIG( TAG, "Setting up BSB component..." ); }
+    void BsbComponent::schedule_read_back( const uint32_t field_id, const uint32_t timestamp ) {
+      BsbEntity* poller = find_poller( field_id );
+      if( poller != nullptr ) {
+        poller->schedule_read_back( timestamp, 0 );
+      }
+    }
 
     void BsbComponent::dump_config() {
       ESP_LOGCONFIG( TAG, "BSB:" );
       ESP_LOGCONFIG( TAG, "  query interval: %.3fs", this->query_interval_ / 1000.0f );
+      ESP_LOGCONFIG( TAG, "  request timeout: %.3fs", this->request_timeout_ / 1000.0f );
       ESP_LOGCONFIG( TAG, "  retry interval: %.3fs", this->retry_interval_ / 1000.0f );
+      ESP_LOGCONFIG( TAG, "  bus idle: %u bytes, backoff up to %u bytes", this->bus_idle_bytes_, this->bus_backoff_bytes_ );
+      ESP_LOGCONFIG( TAG, "  passive refresh: %s (staleness %.2f)", YESNO( this->passive_refresh_ ), this->passive_staleness_ );
+      ESP_LOGCONFIG( TAG, "  metrics interval: %.3fs", this->metrics_interval_ / 1000.0f );
+#ifdef USE_BSB_VALUE_CACHE
+      ESP_LOGCONFIG( TAG, "  value cache interval: %.3fs", this->value_cache_interval_ / 1000.0f );
+#endif
+#ifdef USE_BSB_RECEIVE_TASK
+      ESP_LOGCONFIG( TAG, "  receive task: %s", YESNO( this->use_receive_task_ ) );
+#endif
       ESP_LOGCONFIG( TAG, "  source address: 0x%02X", this->source_address_ );
       ESP_LOGCONFIG( TAG, "  destination address: 0x%02X", this->destination_address_ );
+      ESP_LOGCONFIG( TAG,
+                     "  polled fields: %u of %u entities",
+                     ( unsigned )std::count_if( entities_.cbegin(),
+                                                entities_.cend(),
+                                                []( const BsbDispatchEntry& entry ) { return entry.entity->is_polled(); } ),
+                     ( unsigned )entities_.size() );
 
       ESP_LOGCONFIG( TAG, "  Sensors:" );
-      for( const auto& item : sensors_ ) {
-        BsbSensorBase* s = item.second;
+      for( const auto& entry : entities_ ) {
+        if( entry.kind != BsbEntityKind::Sensor ) {
+          continue;
+        }
+        BsbSensorBase* s = static_cast< BsbSensorBase* >( entry.entity );
         // ESP_LOGCONFIG( TAG, "    parameter number: %u", s->get_parameter_number() );
         switch( s->get_type() ) {
           case SensorType::Sensor:
@@ -51,10 +221,16 @@ namespace esphome {
         }
         ESP_LOGCONFIG( TAG, "    field ID: 0x%08X", s->get_field_id() );
         ESP_LOGCONFIG( TAG, "    update_interval: %.3fs", s->get_update_interval() / 1000.0f );
+        if( s->is_adaptive() ) {
+          ESP_LOGCONFIG( TAG, "    adaptive, now: %.3fs", s->get_poll_interval() / 1000.0f );
+        }
       }
       ESP_LOGCONFIG( TAG, "  Numbers:" );
-      for( const auto& item : numbers_ ) {
-        BsbNumberBase* n = item.second;
+      for( const auto& entry : entities_ ) {
+        if( entry.kind != BsbEntityKind::Number ) {
+          continue;
+        }
+        BsbNumberBase* n = static_cast< BsbNumberBase* >( entry.entity );
         // ESP_LOGCONFIG( TAG, "    parameter number: %u", s->get_parameter_number() );
         switch( n->get_type() ) {
           case NumberType::Number:
@@ -74,207 +250,439 @@ namespace esphome {
         }
         ESP_LOGCONFIG( TAG, "    field ID: 0x%08X", n->get_field_id() );
         ESP_LOGCONFIG( TAG, "    update_interval: %.3fs", n->get_update_interval() / 1000.0f );
+        if( n->is_adaptive() ) {
+          ESP_LOGCONFIG( TAG, "    adaptive, now: %.3fs", n->get_poll_interval() / 1000.0f );
+        }
       }
       ESP_LOGCONFIG( TAG, "  Selects:" );
-      for( const auto& item : selects_ ) {
-        BsbSelect* s = item.second;
+      for( const auto& entry : entities_ ) {
+        if( entry.kind != BsbEntityKind::Select ) {
+          continue;
+        }
+        BsbSelect* s = static_cast< BsbSelect* >( entry.entity );
         ESP_LOGCONFIG( TAG, "  - type: Select" );
         ESP_LOGCONFIG( TAG, "    field ID: 0x%08X", s->get_field_id() );
         ESP_LOGCONFIG( TAG, "    update_interval: %.3fs", s->get_update_interval() / 1000.0f );
+        if( s->is_adaptive() ) {
+          ESP_LOGCONFIG( TAG, "    adaptive, now: %.3fs", s->get_poll_interval() / 1000.0f );
+        }
+      }
+#ifdef USE_TEXT
+      ESP_LOGCONFIG( TAG, "  Time programs:" );
+      for( const auto& entry : entities_ ) {
+        // listed once, by the entry of Monday
+        if( entry.kind != BsbEntityKind::TimeProgram || entry.field_id != entry.entity->get_field_id() ) {
+          continue;
+        }
+        BsbTimeProgram* p = static_cast< BsbTimeProgram* >( entry.entity );
+        ESP_LOGCONFIG( TAG, "  - type: Time Program" );
+        ESP_LOGCONFIG( TAG, "    field IDs: 0x%08X-0x%08X", p->get_field_id(), p->get_day_field_id( TimeProgramDays - 1 ) );
+        ESP_LOGCONFIG( TAG, "    update_interval: %.3fs", p->get_update_interval() / 1000.0f );
+        if( p->is_adaptive() ) {
+          ESP_LOGCONFIG( TAG, "    adaptive, now: %.3fs", p->get_poll_interval() / 1000.0f );
+        }
+      }
+#endif
+    }
+
+    void BsbComponent::on_shutdown() {
+#ifdef USE_BSB_RECEIVE_TASK
+      if( receive_task_ != nullptr ) {
+        receive_task_->stop();
+      }
+#endif
+    }
+
+    // before a reboot or an OTA update, the cache gets the latest values and goes to flash right away
+    void BsbComponent::on_safe_shutdown() {
+#ifdef USE_BSB_VALUE_CACHE
+      if( value_cache_interval_ != 0 ) {
+        save_values( millis() );
+        global_preferences->sync();
+      }
+#endif
+    }
+
+    void BsbComponent::receive() {
+      uint8_t block[ReceiveBlockSize];
+      int     available;
+      while( ( available = this->available() ) > 0 ) {
+        size_t len = std::min( ( size_t )available, sizeof( block ) );
+        if( !this->read_array( block, len ) ) {
+          break;
+        }
+        invert_bytes( block, len );
+        bsbPacketReceive.loop( block, len );
+        metrics_.bytes_in += len;
+
+        last_receive_us_ = micros();
+        backoff_us_      = bus_backoff_bytes_ == 0 ? 0 : random_uint32() % ( bus_backoff_bytes_ * ByteTimeUs + 1 );
       }
+      metrics_.framing_errors = bsbPacketReceive.get_resyncs();
     }
 
+#ifdef USE_BSB_RECEIVE_TASK
+    // the frames the receive task queued since the last call, in the order they arrived
+    void BsbComponent::dispatch_received_frames() {
+      const BsbReceivedFrame* frame;
+      while( ( frame = receive_task_->front() ) != nullptr ) {
+        if( frame->crc_ok ) {
+          callback_packet( &frame->packet, frame->received_us );
+        } else {
+          callback_crc_error( &frame->packet, frame->received_us );
+        }
+        receive_task_->pop();
+      }
+
+      const uint32_t received_us = receive_task_->get_last_receive_us();
+      if( received_us != last_receive_us_ ) {
+        last_receive_us_ = received_us;
+        backoff_us_      = bus_backoff_bytes_ == 0 ? 0 : random_uint32() % ( bus_backoff_bytes_ * ByteTimeUs + 1 );
+      }
+
+      metrics_.bytes_in       = receive_task_->get_bytes();
+      metrics_.framing_errors = receive_task_->get_resyncs();
+      if( receive_task_->get_dropped() != metrics_.frames_dropped ) {
+        ESP_LOGW( TAG, "receive queue full, %u frames dropped", receive_task_->get_dropped() - metrics_.frames_dropped );
+        metrics_.frames_dropped = receive_task_->get_dropped();
+      }
+    }
+#endif
+
     void BsbComponent::loop() {
       const uint32_t now = millis();
 
-      while( this->available() ) {
-        bsbPacketReceive.loop( this->read() ^ 0xff );
+#ifdef USE_BSB_RECEIVE_TASK
+      if( receive_task_ != nullptr ) {
+        dispatch_received_frames();
+      } else {
+        receive();
       }
+#else
+      receive();
+#endif
 
-      if( now > last_query_ ) {
-        last_query_ = now + query_interval_;
-
-        bool packetSent = false;
+      if( transaction_.pending && now - transaction_.sent >= request_timeout_ ) {
+        ESP_LOGD( TAG, "%08X: no answer after %ums", transaction_.field_id, now - transaction_.sent );
+        transaction_.pending = false;
+        write_batch_         = false;
+        ++metrics_.timeouts;
+      }
 
-        for( auto& number : numbers_ ) {
-          if( number.second->is_ready_to_set( now ) ) {
-            write_packet( number.second->createPackageSet( source_address_, destination_address_ ) );
+      if( !transaction_.pending && is_bus_idle( micros() ) ) {
+        scheduler_.release( now );
+        BsbSchedulerItem* next = scheduler_.top();
+
+        // Once a Set was answered, query_interval does not hold back the requests of the batch it belongs to: the other
+        // queued Sets go out back to back, paced by the answers and the idle bus only. Read-backs have a later deadline
+        // than Sets, so they follow together once all Sets are answered, again back to back. Any other request ends the
+        // batch.
+        const bool batched = next != nullptr && write_batch_ &&
+                             ( static_cast< BsbEntity* >( next )->is_ready_to_set( now ) ||
+                               static_cast< BsbEntity* >( next )->is_reading_back() );
+        if( !batched && now <= last_query_ ) {
+          next = nullptr;
+        } else {
+          last_query_ = now + query_interval_;
+        }
+        write_batch_ = batched;
 
-            if( number.second->get_broadcast() ) {
-              number.second->reset_dirty();
-              number.second->publish();
-            } else {
-              number.second->schedule_next_update( now, IntervalGetAfterSet );
-            }
+        if( next != nullptr ) {
+          BsbEntity* entity = static_cast< BsbEntity* >( next );
 
-            packetSent = true;
-            break;
+          // entities polled for the first time and the days of a time program were due at boot
+          if( next->get_due() != 0 && now > next->get_deadline() ) {
+            metrics_.scheduler_overrun = std::max( metrics_.scheduler_overrun, now - next->get_deadline() );
           }
-          if( number.second->is_ready_to_update( now ) ) {
-            if( !number.second->get_broadcast() ) {
-              write_packet( number.second->createPackageGet( source_address_, destination_address_ ) );
 
-              packetSent = true;
-              break;
-            }
-          }
-        }
+          if( entity->is_ready_to_set( now ) ) {
+            switch( entity->get_entity_kind() ) {
+              case BsbEntityKind::Number: {
+                BsbNumberBase*  number = static_cast< BsbNumberBase* >( entity );
+                const BsbPacket packet = number->createPackageSet( source_address_, destination_address_, now );
+                count_retries( number->get_sent_sets() );
+                write_packet( packet );
+
+                if( number->get_broadcast() ) {
+                  number->reset_dirty();
+                  number->publish();
+                } else {
+                  begin_transaction( packet, now );
+                }
+              } break;
 
-        if( !packetSent ) {
-          for( auto& select : selects_ ) {
-            if( select.second->is_ready_to_set( now ) ) {
-              write_packet( select.second->createPackageSet( source_address_, destination_address_ ) );
-              select.second->schedule_next_update( now, IntervalGetAfterSet );
-              packetSent = true;
-              break;
+              case BsbEntityKind::Select: {
+                BsbSelect*      select = static_cast< BsbSelect* >( entity );
+                const BsbPacket packet = select->createPackageSet( source_address_, destination_address_, now );
+                count_retries( select->get_sent_sets() );
+                write_packet( packet );
+                begin_transaction( packet, now );
+              } break;
+
+#ifdef USE_TEXT
+              case BsbEntityKind::TimeProgram: {
+                BsbTimeProgram* program = static_cast< BsbTimeProgram* >( entity );
+                const BsbPacket packet  = program->createPackageSet( source_address_, destination_address_, now );
+                count_retries( program->get_sent_sets() );
+                write_packet( packet );
+                begin_transaction( packet, now );
+              } break;
+#endif
+
+              default:
+                break;
             }
-            if( select.second->is_ready_to_update( now ) ) {
-              write_packet( select.second->createPackageGet( source_address_, destination_address_ ) );
-              packetSent = true;
-              break;
+          } else {
+            if( next->get_due() != 0 ) {
+              metrics_.scheduler_lag.add( now - next->get_due() );
             }
+
+            const BsbPacket packet = entity->createPackageGet( source_address_, destination_address_, now );
+            count_retries( entity->get_sent_gets() );
+            write_packet( packet );
+            begin_transaction( packet, now );
           }
         }
+      }
 
-        if( !packetSent ) {
-          for( auto& sensor : sensors_ ) {
-            if( sensor.second->is_ready( now ) ) {
-              write_packet( sensor.second->createPackageGet( source_address_, destination_address_ ) );
+      if( metrics_interval_ != 0 && now - last_metrics_publish_ >= metrics_interval_ ) {
+        publish_metrics( now );
+      }
 
-              break;
-            }
-          }
+#ifdef USE_BSB_VALUE_CACHE
+      if( value_cache_interval_ != 0 && now - last_value_cache_save_ >= value_cache_interval_ ) {
+        save_values( now );
+      }
+#endif
+
+      // the main loop usually sleeps about 16ms between calls, which would add up over a batch
+      if( write_batch_ || ( transaction_.pending && transaction_.command == BsbPacket::Command::Set ) ) {
+        high_frequency_.start();
+      } else {
+        high_frequency_.stop();
+      }
+    }
+
+    void BsbComponent::count_retries( const uint16_t sent ) {
+      if( sent == 0 ) {
+        ++metrics_.retries_exhausted;
+      } else if( sent > 1 ) {
+        ++metrics_.retries;
+      }
+    }
+
+    void BsbComponent::publish_metrics( const uint32_t now ) {
+      const float period = ( now - last_metrics_publish_ ) / 1000.0f;
+      const float values[( uint8_t )BsbMetric::Count] = {
+        ( float )metrics_.bytes_in,
+        ( float )metrics_.bytes_out,
+        ( metrics_.frames_in + metrics_.frames_out - frames_at_publish_ ) / period,
+        ( float )metrics_.crc_errors,
+        ( float )metrics_.framing_errors,
+        ( float )metrics_.latency.percentile( 0.5f ),
+        ( float )metrics_.latency.percentile( 0.9f ),
+        ( float )metrics_.latency.percentile( 0.99f ),
+        ( float )metrics_.retries,
+        ( float )metrics_.retries_exhausted,
+        ( float )metrics_.nacks,
+        ( float )metrics_.timeouts,
+        ( float )metrics_.scheduler_lag.percentile( 0.9f ),
+        ( float )metrics_.scheduler_lag.max(),
+        ( float )metrics_.scheduler_overrun,
+        ( float )metrics_.frames_dropped,
+        ( float )count_stale_values(),
+      };
+
+      for( uint8_t i = 0; i < ( uint8_t )BsbMetric::Count; i++ ) {
+        if( metric_sensors_[i] != nullptr ) {
+          metric_sensors_[i]->publish_state( values[i] );
         }
       }
+
+      last_metrics_publish_ = now;
+      frames_at_publish_    = metrics_.frames_in + metrics_.frames_out;
+      metrics_.latency.clear();
+      metrics_.scheduler_lag.clear();
+      metrics_.scheduler_overrun = 0;
     }
 
-    void BsbComponent::callback_packet( const BsbPacket* packet ) {
-      ESP_LOGD( TAG, "<<< %s", ( packet->print_packet() ).c_str() );
+    void BsbComponent::begin_transaction( const BsbPacket& packet, const uint32_t timestamp ) {
+      if( packet.buffer.empty() ) {
+        return;
+      }
 
-      if( packet->command == BsbPacket::Command::Inf || packet->command == BsbPacket::Command::Ret ) {
-        {
-          auto range = sensors_.equal_range( packet->fieldId );
-
-          for( auto sensor = range.first; sensor != range.second; ++sensor ) {
-            switch( sensor->second->get_type() ) {
-              case SensorType::Sensor: {
-                BsbSensor* bsbSensor = ( BsbSensor* )sensor->second;
-                bsbSensor->schedule_next_regular_update( millis() );
-                switch( bsbSensor->get_value_type() ) {
-                  case BsbSensorValueType::UInt8:
-                    bsbSensor->set_value( packet->parse_as_uint8() );
-                    break;
-                  case BsbSensorValueType::Int8:
-                    bsbSensor->set_value( packet->parse_as_int8() );
-                    break;
-                  case BsbSensorValueType::Int16:
-                    bsbSensor->set_value( packet->parse_as_int16() );
-                    break;
-                  case BsbSensorValueType::Int32:
-                    bsbSensor->set_value( packet->parse_as_int32() );
-                    break;
-                  case BsbSensorValueType::Temperature:
-                    bsbSensor->set_value( packet->parse_as_temperature() );
-                    break;
-                }
-                bsbSensor->publish();
-              } break;
+      transaction_.command     = packet.command;
+      transaction_.field_id    = packet.fieldId;
+      transaction_.destination = packet.destinationAddress;
+      transaction_.sent        = timestamp;
+      transaction_.pending     = true;
+    }
 
-#ifdef USE_TEXT_SENSOR
-              case SensorType::TextSensor: {
-                BsbTextSensor* bsbSensor = ( BsbTextSensor* )sensor->second;
-                bsbSensor->schedule_next_regular_update( millis() );
-                if (bsbSensor->get_value_type() == BsbSensorValueType::DateTime) {
-                  bsbSensor->set_value( packet->parse_as_datetime() );
-                } else if (bsbSensor->has_enum_mapping()) {
-                  bsbSensor->set_value_int( packet->parse_as_int8() );
-                } else {
-                  bsbSensor->set_value( packet->parse_as_text() );
-                }
-                bsbSensor->publish();
-              } break;
+    // the bus counts as idle when no frame is being received and nothing was received for bus_idle_bytes byte times plus
+    // the random backoff, so masters waiting for the same gap do not all start sending at once. A frame that was cut off
+    // leaves the receiver mid-frame, after the time of a full frame of silence the bus is considered idle anyway.
+    bool BsbComponent::is_bus_idle( const uint32_t now_us ) const {
+      const uint32_t silence = now_us - last_receive_us_;
+      if( silence < bus_idle_bytes_ * ByteTimeUs + backoff_us_ ) {
+        return false;
+      }
+#ifdef USE_BSB_RECEIVE_TASK
+      const bool receiver_idle = receive_task_ != nullptr ? receive_task_->is_idle() : bsbPacketReceive.is_idle();
+#else
+      const bool receiver_idle = bsbPacketReceive.is_idle();
 #endif
+      return receiver_idle || silence >= BsbPacket::MaxPacketSize * ByteTimeUs;
+    }
 
-#ifdef USE_BINARY_SENSOR
-              case SensorType::BinarySensor: {
-                BsbBinarySensor* bsbSensor = ( BsbBinarySensor* )sensor->second;
-                bsbSensor->schedule_next_regular_update( millis() );
-                // BSB on/off values are always byte-sized; use uint8_t to avoid
-                // sign extension of 0xFF (which BSB-LAN documents as a valid "on" value).
-                bsbSensor->set_value( packet->parse_as_uint8() );
-                bsbSensor->publish();
-              } break;
+    bool BsbComponent::is_answer( const BsbPacket* packet ) const {
+      if( !transaction_.pending || packet->destinationAddress != source_address_ || packet->sourceAddress != transaction_.destination ||
+          packet->fieldId != transaction_.field_id ) {
+        return false;
+      }
+
+      switch( transaction_.command ) {
+        case BsbPacket::Command::Get:
+          return packet->command == BsbPacket::Command::Ret;
+        case BsbPacket::Command::Set:
+          return packet->command == BsbPacket::Command::Ack || packet->command == BsbPacket::Command::Nack;
+        default:
+          return false;
+      }
+    }
+
+    void BsbComponent::callback_packet( const BsbPacket* packet, const uint32_t received_us ) {
+#ifdef BSB_TRACE_SIZE
+      trace_.record( BsbTraceDirection::Receive, BsbTraceRecord::CrcOk, received_us, packet->buffer.data(), packet->buffer.size() );
 #endif
-            }
-          }
+      if( packet_log_enabled() ) {
+        ESP_LOGD( TAG, "<<< %s", ( packet->print_packet() ).c_str() );
+      }
+
+      ++metrics_.frames_in;
+
+      const bool answer = is_answer( packet );
+      if( answer ) {
+        transaction_.pending = false;
+
+        if( packet->command == BsbPacket::Command::Ret ) {
+          metrics_.latency.add( millis() - transaction_.sent );
+        } else if( packet->command == BsbPacket::Command::Nack ) {
+          ++metrics_.nacks;
         }
+      }
 
-        {
-          auto range = numbers_.equal_range( packet->fieldId );
-          for( auto number = range.first; number != range.second; ++number ) {
-            BsbNumberBase* bsbNumber = number->second;
-            bsbNumber->schedule_next_regular_update( millis() );
-            switch( bsbNumber->get_value_type() ) {
-              case BsbNumberValueType::UInt8:
-                bsbNumber->set_value( packet->parse_as_uint8() );
-                break;
-              case BsbNumberValueType::Int8:
-                bsbNumber->set_value( packet->parse_as_int8() );
-                break;
-              case BsbNumberValueType::Int16:
-                bsbNumber->set_value( packet->parse_as_int16() );
-                break;
-              case BsbNumberValueType::Int32:
-                bsbNumber->set_value( packet->parse_as_int32() );
-                break;
-              case BsbNumberValueType::Temperature:
-                bsbNumber->set_value( packet->parse_as_temperature() );
-                break;
-              default:
-                break;
-            }
-          }
+      const auto range = find_entities( packet->fieldId );
+      if( range.first == range.second ) {
+        return;
+      }
+
+      if( packet->command == BsbPacket::Command::Inf || packet->command == BsbPacket::Command::Ret ) {
+        const uint32_t now = millis();
+        for( auto entry = range.first; entry != range.second; ++entry ) {
+          entry->entity->decode( packet, now );
         }
+#ifdef USE_BSB_VALUE_CACHE
+        if( value_cache_interval_ != 0 ) {
+          value_cache_.update( packet );
+        }
+#endif
 
-        {
-          auto range = selects_.equal_range( packet->fieldId );
-          for( auto select = range.first; select != range.second; ++select ) {
-            BsbSelect* bsbSelect = select->second;
-            bsbSelect->schedule_next_regular_update( millis() );
-            bsbSelect->set_value( packet->parse_as_int8() );
-            bsbSelect->publish();
+        // broadcasts and answers to other devices, in contrast to the answers to our own Gets, tell how often a field
+        // is refreshed without us polling it
+        const bool overheard = packet->sourceAddress != source_address_ &&
+                               ( packet->command == BsbPacket::Command::Inf || packet->destinationAddress != source_address_ );
+        if( passive_refresh_ && overheard ) {
+          BsbEntity* poller = find_poller( packet->fieldId );
+          if( poller != nullptr &&
+              poller->overheard( now, ( uint32_t )( poller->get_update_interval() * passive_staleness_ ) ) ) {
+            ++avoided_polls_;
           }
         }
       }
 
-      if( packet->command == BsbPacket::Command::Ack || packet->command == BsbPacket::Command::Nack ) {
-        {
-          auto range = numbers_.equal_range( packet->fieldId );
-          for( auto number = range.first; number != range.second; ++number ) {
-            number->second->reset_dirty();
+      // the answer to our Set: the value is confirmed by reading it back in the next bus slot, or right away for
+      // optimistic entities; a refused value is reverted to the last confirmed one
+      if( answer && ( packet->command == BsbPacket::Command::Ack || packet->command == BsbPacket::Command::Nack ) ) {
+        const bool     accepted  = packet->command == BsbPacket::Command::Ack;
+        const uint32_t now       = millis();
+        bool           read_back = false;
+
+        write_batch_ = true;
+
+        for( auto entry = range.first; entry != range.second; ++entry ) {
+          BsbEntity* entity = entry->entity;
+          switch( entry->kind ) {
+            case BsbEntityKind::Sensor:
+              break;
+#ifdef USE_TEXT
+            case BsbEntityKind::TimeProgram:
+              static_cast< BsbTimeProgram* >( entity )->acknowledged( packet->fieldId, accepted, now );
+              break;
+#endif
+            default:
+              // the answer to a Set of an older value: the entity stays dirty and the latest value is sent next
+              if( !entity->is_latest_edit_sent() ) {
+                break;
+              }
+              entity->reset_dirty();
+              if( !accepted ) {
+                ESP_LOGW( TAG, "Set %08X: refused, reverting", packet->fieldId );
+                entity->revert();
+              } else if( entity->is_optimistic() ) {
+                entity->commit();
+              } else {
+                entity->expect_confirmation();
+                read_back = true;
+              }
+              break;
           }
         }
 
-        {
-          auto range = selects_.equal_range( packet->fieldId );
-          for( auto select = range.first; select != range.second; ++select ) {
-            select->second->reset_dirty();
-          }
+        if( read_back ) {
+          schedule_read_back( packet->fieldId, now );
         }
       }
     }
 
+    void BsbComponent::callback_crc_error( const BsbPacket* packet, const uint32_t received_us ) {
+      ++metrics_.crc_errors;
+#ifdef BSB_TRACE_SIZE
+      trace_.record( BsbTraceDirection::Receive, 0, received_us, packet->buffer.data(), packet->buffer.size() );
+#endif
+      if( packet_log_enabled() ) {
+        ESP_LOGD( TAG, "<<< CRC error: %s", format_hex_pretty( packet->buffer.data(), packet->buffer.size() ).c_str() );
+      }
+    }
+
     void BsbComponent::write_packet( const BsbPacket& packet ) {
       if( !packet.buffer.empty() ) {
-        ESP_LOGD( TAG, ">>> %s", ( packet.print_packet() ).c_str() );
+#ifdef BSB_TRACE_SIZE
+        trace_.record( BsbTraceDirection::Transmit, BsbTraceRecord::CrcOk, micros(), packet.buffer.data(), packet.buffer.size() );
+#endif
+        if( packet_log_enabled() ) {
+          ESP_LOGD( TAG, ">>> %s", ( packet.print_packet() ).c_str() );
+        }
 
         auto buffer = packet.buffer;
-        for( auto& b : buffer ) {
-          b ^= 0xff;
-        }
-        write_array( buffer );
+        invert_bytes( buffer.data(), buffer.size() );
+        write_array( buffer.data(), buffer.size() );
+
+        metrics_.bytes_out += buffer.size();
+        ++metrics_.frames_out;
       }
     }
 
+#ifdef BSB_TRACE_SIZE
+    void BsbComponent::dump_trace() {
+      ESP_LOGI( TAG, "Trace: last %u of %u frames", ( unsigned )trace_.size(), ( unsigned )trace_.get_total() );
+
+      char line[160];
+      for( size_t i = 0; i < trace_.size(); i++ ) {
+        format_trace_record( trace_[i], line, sizeof( line ) );
+        ESP_LOGI( TAG, "%s", line );
+      }
+    }
+#endif
+
   } // namespace bsb
 } // namespace esphome
@@ -7,22 +7,42 @@
   #include "esphome/components/binary_sensor/binary_sensor.h"
 #endif
 #include "bsbNumber.h"
+#include "bsbScheduler.h"
 #include "bsbSelect.h"
 #include "bsbSensor.h"
+#include "bsbTimeProgram.h"
+#include "bsbCapture.h"
+#include "bsbMetrics.h"
+#include "bsbTrace.h"
 
 #include <cstdint>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "bsbPacketReceive.h"
+#ifdef USE_BSB_VALUE_CACHE
+  #include "bsbValueCache.h"
+#endif
+#ifdef USE_BSB_RECEIVE_TASK
+  #include <memory>
+
+  #include "bsbReceiveTask.h"
+#endif
 
 namespace esphome {
   namespace bsb {
 
     extern const char* const TAG;
 
-    using SensorMap = std::unordered_multimap< uint32_t, BsbSensorBase* >;
-    using NumberMap = std::unordered_multimap< uint32_t, BsbNumberBase* >;
-    using SelectMap = std::unordered_multimap< uint32_t, BsbSelect* >;
+    // one entry per entity; sorted by field ID in setup(), so the entities of a field lie next to each other and are
+    // found with a binary search
+    struct BsbDispatchEntry {
+      uint32_t      field_id;
+      BsbEntityKind kind;
+      BsbEntity*    entity;
+    };
+
+    using DispatchTable = std::vector< BsbDispatchEntry >;
 
     class BsbComponent
         : public Component
@@ -33,6 +53,8 @@ namespace esphome {
       void  setup() override;
       void  dump_config() override;
       void  loop() override;
+      void  on_shutdown() override;
+      void  on_safe_shutdown() override;
       float get_setup_priority() const override { return setup_priority::DATA; };
 
       void           set_source_address( uint32_t val ) { source_address_ = val; }
@@ -41,38 +63,161 @@ namespace esphome {
       const uint8_t  get_destination_address() const { return destination_address_; }
 
       void set_query_interval( uint32_t val ) { query_interval_ = val; }
+      void set_request_timeout( uint32_t val ) { request_timeout_ = val; }
+      void set_bus_idle_bytes( uint8_t val ) { bus_idle_bytes_ = val; }
+      void set_bus_backoff_bytes( uint8_t val ) { bus_backoff_bytes_ = val; }
+      void set_passive_refresh( bool val ) { passive_refresh_ = val; }
+      void set_passive_staleness( float val ) { passive_staleness_ = val; }
+#ifdef USE_BSB_RECEIVE_TASK
+      // receive in a task of its own instead of in loop(), see BsbReceiveTask
+      void set_receive_task( bool val ) { use_receive_task_ = val; }
+#endif
+
+#ifdef USE_BSB_VALUE_CACHE
+      // keep the last value of each field in flash, saving the changed ones every interval, see BsbValueCache
+      void set_value_cache_interval( uint32_t val ) { value_cache_interval_ = val; }
+#endif
+      // entities showing a value from before the last reboot that was not read from the bus again yet
+      uint16_t count_stale_values() const;
+
+      // polls that were not needed because the field was broadcast in time
+      uint32_t get_avoided_polls() const { return avoided_polls_; }
+
+      // bus health, published every metrics interval to the sensors attached to it
+      const BsbMetrics& get_metrics() const { return metrics_; }
+      void              set_metrics_interval( uint32_t val ) { metrics_interval_ = val; }
+      void              set_metric_sensor( BsbMetric metric, sensor::Sensor* sensor ) { metric_sensors_[( uint8_t )metric] = sensor; }
 
       void           set_retry_interval( uint32_t val ) { retry_interval_ = val; }
       const uint32_t get_retry_interval() const { return retry_interval_; }
       void           set_retry_count( uint8_t val ) { retry_count_ = val; }
       const uint8_t  get_retry_count() const { return retry_count_; }
 
-      void register_sensor( BsbSensorBase* sensor ) { this->sensors_.insert( { sensor->get_field_id(), sensor } ); }
-      void register_number( BsbNumberBase* number ) { this->numbers_.insert( { number->get_field_id(), number } ); }
-      void register_select( BsbSelect* select ) { this->selects_.insert( { select->get_field_id(), select } ); }
+      void register_sensor( BsbSensorBase* sensor ) { register_entity( sensor ); }
+      void register_number( BsbNumberBase* number ) { register_entity( number ); }
+      void register_select( BsbSelect* select ) { register_entity( select ); }
+#ifdef USE_TEXT
+      // one dispatch entry per day, the answers of all of them go to the time program
+      void register_time_program( BsbTimeProgram* program ) {
+        for( uint8_t day = 0; day < TimeProgramDays; day++ ) {
+          this->entities_.push_back( { program->get_day_field_id( day ), BsbEntityKind::TimeProgram, program } );
+        }
+        this->scheduler_.add( program );
+      }
+#endif
 
       void write_packet( const BsbPacket& packet );
 
+#ifdef BSB_TRACE_SIZE
+      // the last frames on the bus, formatted only when read
+      const BsbTrace< BSB_TRACE_SIZE >& get_trace() const { return trace_; }
+      // logs the frames in the trace, oldest first
+      void dump_trace();
+#endif
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+      void set_web_server( web_server_base::WebServerBase* base ) { this->base_ = base; }
+#endif
+
     protected:
-      void callback_packet( const BsbPacket* packet );
+      // a Get or Set waiting for its answer. The bus carries one request at a time, the next one is sent as soon as this
+      // one is answered or timed out.
+      struct Transaction {
+        BsbPacket::Command command;
+        uint32_t           field_id;
+        uint8_t            destination;
+        uint32_t           sent;
+        bool               pending = false;
+      };
+
+      void receive();
+#ifdef USE_BSB_RECEIVE_TASK
+      void dispatch_received_frames();
+#endif
+
+      void callback_packet( const BsbPacket* packet, const uint32_t received_us );
+      void callback_crc_error( const BsbPacket* packet, const uint32_t received_us );
 
-      BsbPacketReceive bsbPacketReceive = BsbPacketReceive( [&]( const BsbPacket* packet ) { callback_packet( packet ); } );
+      void begin_transaction( const BsbPacket& packet, const uint32_t timestamp );
+      bool is_answer( const BsbPacket* packet ) const;
+      bool is_bus_idle( const uint32_t now_us ) const;
 
-      SensorMap sensors_;
-      NumberMap numbers_;
-      SelectMap selects_;
+      void register_entity( BsbEntity* entity ) {
+        this->entities_.push_back( { entity->get_field_id(), entity->get_entity_kind(), entity } );
+        this->scheduler_.add( entity );
+      }
+
+      // the entries of all entities mapped to field_id, as [first, last)
+      std::pair< const BsbDispatchEntry*, const BsbDispatchEntry* > find_entities( const uint32_t field_id ) const;
+      BsbEntity*                                                    find_poller( const uint32_t field_id ) const;
+
+      void count_retries( const uint16_t sent );
+      void publish_metrics( const uint32_t now );
+
+      void plan_polls();
+#ifdef USE_BSB_VALUE_CACHE
+      void restore_values();
+      void save_values( const uint32_t now );
+#endif
+      void schedule_read_back( const uint32_t field_id, const uint32_t timestamp );
+
+      BsbPacketReceive bsbPacketReceive = BsbPacketReceive( [&]( const BsbPacket* packet ) { callback_packet( packet, micros() ); } );
+#ifdef USE_BSB_VALUE_CACHE
+      BsbValueCache value_cache_;
+      uint32_t      value_cache_interval_  = 0;
+      uint32_t      last_value_cache_save_ = 0;
+#endif
+#ifdef USE_BSB_RECEIVE_TASK
+      bool                              use_receive_task_ = false;
+      std::unique_ptr< BsbReceiveTask > receive_task_;
+#endif
+
+      DispatchTable entities_;
+
+      // all entities, ordered by when they have to be read or written next
+      BsbScheduler scheduler_;
 
       uint32_t query_interval_;
+      uint32_t request_timeout_;
       uint32_t retry_interval_;
       uint8_t  retry_count_;
+      uint8_t  bus_idle_bytes_    = 0;
+      uint8_t  bus_backoff_bytes_ = 0;
+      bool     passive_refresh_   = false;
+      float    passive_staleness_ = 1.5f;
+      uint32_t avoided_polls_     = 0;
+
+      BsbMetrics      metrics_;
+      sensor::Sensor* metric_sensors_[( uint8_t )BsbMetric::Count] = {};
+      uint32_t        metrics_interval_                             = 60000;
+      uint32_t        last_metrics_publish_                         = 0;
+      uint32_t        frames_at_publish_                            = 0;
 
       uint8_t source_address_;
       uint8_t destination_address_;
 
+      Transaction transaction_;
+
+#ifdef BSB_TRACE_SIZE
+      BsbTrace< BSB_TRACE_SIZE > trace_;
+#endif
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+      web_server_base::WebServerBase* base_ = nullptr;
+#endif
+
+      // time of the last received byte and the random delay drawn for the idle period following it
+      uint32_t last_receive_us_ = 0;
+      uint32_t backoff_us_      = 0;
+
     private:
       uint32_t last_query_ = 0;
-
-      static constexpr uint32_t IntervalGetAfterSet = 1000;
+      // a Set was answered and the requests since belonged to its batch, further Sets and read-backs follow right away
+      bool                       write_batch_ = false;
+      HighFrequencyLoopRequester high_frequency_;
+
+      // bytes read from the UART in one go; a full telegram fits, more are read in further blocks
+      static constexpr size_t ReceiveBlockSize = 32;
+      // one byte on the bus: start bit, 8 data bits, parity and stop bit at 4800 baud
+      static constexpr uint32_t ByteTimeUs = 11 * 1000000 / 4800;
     };
 
   } // namespace bsb
@@ -50,16 +50,16 @@ namespace esphome {
         // Byte 6: minute
         // Byte 7: second
         // Byte 8: date_flag (0x00 for VT_DATETIME)
-        packet.payload.clear();
-        packet.payload.push_back( 0x01 );                              // enable_byte
-        packet.payload.push_back( now.year - 1900 );                   // year - 1900
-        packet.payload.push_back( now.month );                         // month
-        packet.payload.push_back( now.day_of_month );                  // day
-        packet.payload.push_back( ( now.day_of_week + 6 ) % 7 );       // day of week (convert 1-7 Mon-Sun to 0-6)
-        packet.payload.push_back( now.hour );                          // hour
-        packet.payload.push_back( now.minute );                        // minute
-        packet.payload.push_back( now.second );                        // second
-        packet.payload.push_back( 0x00 );                              // date_flag
+        packet.clear_payload();
+        packet.add_payload( 0x01 );                              // enable_byte
+        packet.add_payload( now.year - 1900 );                   // year - 1900
+        packet.add_payload( now.month );                         // month
+        packet.add_payload( now.day_of_month );                  // day
+        packet.add_payload( ( now.day_of_week + 6 ) % 7 );       // day of week (convert 1-7 Mon-Sun to 0-6)
+        packet.add_payload( now.hour );                          // hour
+        packet.add_payload( now.minute );                        // minute
+        packet.add_payload( now.second );                        // second
+        packet.add_payload( 0x00 );                              // date_flag
 
         packet.create_packet();
         this->bsb_component_->write_packet( packet );
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+
+  #include <cstdint>
+  #include <string>
+
+  #include "bsbTrace.h"
+
+  #include "esphome/components/web_server_base/web_server_base.h"
+  #include "esphome/core/helpers.h"
+
+namespace esphome {
+  namespace bsb {
+
+    // Serves the packet trace as a pcap file at /bsb/capture.pcap. handleRequest() runs in the task of the web server,
+    // not in loop(): the records are written into the response one at a time while holding the lock of the trace. The
+    // response owns the only copy of the file, so requests that overlap do not share a buffer.
+    template< size_t Capacity >
+    class BsbCaptureHandler : public AsyncWebHandler {
+    public:
+      explicit BsbCaptureHandler( const BsbTrace< Capacity >* trace ) : trace_( trace ) {}
+
+      bool canHandle( AsyncWebServerRequest* request ) override {
+        return request->method() == HTTP_GET && request->url() == "/bsb/capture.pcap";
+      }
+
+      void handleRequest( AsyncWebServerRequest* request ) override {
+        AsyncResponseStream* response = request->beginResponseStream( "application/vnd.tcpdump.pcap" );
+        {
+          LockGuard guard( trace_->get_lock() );
+          write_pcap( *trace_, [response]( const uint8_t* data, const size_t size ) {
+  #ifdef USE_ARDUINO
+            response->write( data, size );
+  #else
+            response->print( std::string( reinterpret_cast< const char* >( data ), size ) );
+  #endif
+          } );
+        }
+        response->addHeader( "Content-Disposition", "attachment; filename=\"bsb.pcap\"" );
+        request->send( response );
+      }
+
+    protected:
+      const BsbTrace< Capacity >* trace_;
+    };
+
+  } // namespace bsb
+} // namespace esphome
+
+#endif
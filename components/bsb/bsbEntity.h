@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "bsbPacket.h"
+#include "bsbPacketSend.h"
+#include "bsbScheduler.h"
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+  namespace bsb {
+    extern const char* const TAG;
+
+    enum class BsbEntityKind : uint8_t { Sensor, Number, Select, TimeProgram };
+
+    // the raw value of a Ret or Inf telegram, for the decoders of the entities
+    template< typename T >
+    T parse_raw( const BsbPacket* packet );
+
+    template<>
+    inline uint8_t parse_raw< uint8_t >( const BsbPacket* packet ) {
+      return packet->parse_as_uint8();
+    }
+    template<>
+    inline int8_t parse_raw< int8_t >( const BsbPacket* packet ) {
+      return packet->parse_as_int8();
+    }
+    template<>
+    inline int16_t parse_raw< int16_t >( const BsbPacket* packet ) {
+      return packet->parse_as_int16();
+    }
+    template<>
+    inline int32_t parse_raw< int32_t >( const BsbPacket* packet ) {
+      return packet->parse_as_int32();
+    }
+
+    // What all BSB entities have in common: the field they map to and when it is read or written next. The entity is
+    // kept in the scheduler of its BsbComponent by the earlier of both.
+    class BsbEntity : public BsbSchedulerItem {
+    public:
+      explicit BsbEntity( const BsbEntityKind kind ) : kind_( kind ) {}
+
+      BsbEntityKind get_entity_kind() const { return kind_; }
+
+      // Ret and Inf telegrams of the field are decoded, scaled and published by one direct call. The decoder is picked by
+      // select_decoder() in setup(), once the value type and scaling are configured.
+      void decode( const BsbPacket* packet, const uint32_t timestamp ) {
+        stale_ = false;
+        decoder_( this, packet, timestamp );
+      }
+      virtual void select_decoder() = 0;
+
+      // A value from before the last reboot, see BsbValueCache: it is published like a broadcast, but the entity counts
+      // as stale until the field is read from the bus. Its first read is due right away, but may wait for the entities
+      // without any value and for those with a shorter poll interval.
+      void restore( const BsbPacket* packet ) {
+        decoder_( this, packet, 0 );
+        stale_ = true;
+        schedule_next_update( 0, 0 );
+      }
+      bool is_stale() const { return stale_; }
+
+      void           set_field_id( const uint32_t field_id ) { this->field_id_ = field_id; }
+      const uint32_t get_field_id() const { return field_id_; }
+
+      void           set_update_interval( const uint32_t update_interval_ms ) { update_interval_ms_ = update_interval_ms; }
+      const uint32_t get_update_interval() const { return update_interval_ms_; }
+
+      // Adaptive polling: with both limits set, the poll interval halves whenever a read value moved (by more than the
+      // deadbands) and grows by a quarter with every read that found it unchanged, so bus time goes to the fields that
+      // change. It starts at update_interval.
+      void set_min_update_interval( const uint32_t min_update_interval_ms ) { min_update_interval_ms_ = min_update_interval_ms; }
+      void set_max_update_interval( const uint32_t max_update_interval_ms ) { max_update_interval_ms_ = max_update_interval_ms; }
+      bool is_adaptive() const { return max_update_interval_ms_ != 0; }
+
+      // the interval the field is polled at now: update_interval, unless it is adaptive
+      const uint32_t get_poll_interval() const { return poll_interval_ms_ != 0 ? poll_interval_ms_ : update_interval_ms_; }
+
+      // Publish filter for decoded values: with any of these set, a value is only published when it changed by more than
+      // the deadbands, at most every min_publish_interval, and again after heartbeat even when it did not change.
+      // Without them every value is published, as it was received.
+      void set_deadband( const float deadband ) {
+        deadband_ = deadband;
+        filtered_ = true;
+      }
+      void set_relative_deadband( const float relative_deadband ) {
+        relative_deadband_ = relative_deadband;
+        filtered_          = true;
+      }
+      void set_min_publish_interval( const uint32_t min_publish_interval_ms ) {
+        min_publish_interval_ms_ = min_publish_interval_ms;
+        filtered_                = true;
+      }
+      void set_heartbeat( const uint32_t heartbeat_ms ) {
+        heartbeat_ms_ = heartbeat_ms;
+        filtered_     = true;
+      }
+
+      void           set_retry_interval( const uint32_t retry_interval_ms ) { retry_interval_ms_ = retry_interval_ms; }
+      const uint32_t get_retry_interval() const { return retry_interval_ms_; }
+      void           set_retry_count( uint8_t retry_count ) { retry_count_ = retry_count; }
+
+      // entities that are not polled only get updated by telegrams on the bus (and can still be set)
+      void set_polled( const bool polled ) {
+        polled_ = polled;
+        update_due();
+      }
+      bool is_polled() const { return polled_; }
+
+      // A Set is confirmed by reading the value back right after its Ack. Optimistic entities take the Ack as the
+      // confirmation and publish the value sent, without the read.
+      void set_optimistic( const bool optimistic ) { optimistic_ = optimistic; }
+      bool is_optimistic() const { return optimistic_; }
+
+      // a Set waits to be sent or answered
+      bool is_dirty() const { return dirty_; }
+      // the last Set sent carries the latest edit; an answer to an older one leaves the entity dirty, so the latest
+      // value is sent next
+      bool is_latest_edit_sent() const { return dirty_ && sent_edit_ == edit_; }
+
+      // the next value read is the confirmation of an acknowledged Set: it is published even when the publish filter
+      // would hold it back, as nothing published the value set before
+      void expect_confirmation() { confirming_ = true; }
+
+      // the Set was acknowledged: the value sent is the confirmed one
+      virtual void commit() {}
+      // the Set was refused or given up on: the last confirmed value is published again
+      virtual void revert() {}
+
+      // Gets and Sets sent since the last answer; 0 right after sending one means the retries were exhausted
+      uint16_t get_sent_gets() const { return sent_get_; }
+      uint16_t get_sent_sets() const { return sent_set_; }
+
+      bool is_due( const uint32_t timestamp ) const { return timestamp >= get_due(); }
+      bool is_ready_to_set( const uint32_t timestamp ) const { return dirty_ && timestamp >= set_timestamp_; }
+      bool is_reading_back() const { return read_back_; }
+
+      void schedule_next_regular_update( const uint32_t timestamp ) { schedule_next_update( timestamp, get_poll_interval() ); }
+      void schedule_next_update( const uint32_t timestamp, const uint32_t interval ) {
+        sent_get_              = 0;
+        next_update_timestamp_ = timestamp + interval;
+        read_back_             = false;
+        update_due();
+      }
+
+      // a read after a Set, to confirm the value; it is sent ahead of regular reads
+      void schedule_read_back( const uint32_t timestamp, const uint32_t interval ) {
+        schedule_next_update( timestamp, interval );
+        read_back_ = true;
+        update_due();
+      }
+
+      void reset_dirty() {
+        sent_set_         = 0;
+        set_retry_cycles_ = 0;
+        dirty_            = false;
+        update_due();
+      }
+
+      // Passive refresh: a field the controller broadcasts by itself only needs polling when the broadcasts stop. The
+      // broadcast interval is learned from overheard telegrams. Once it was stable for a few telegrams and the next
+      // broadcast is expected within the staleness budget, the next poll is put off until that broadcast is overdue.
+      // Returns true if a regular poll was avoided since the previous broadcast.
+      bool overheard( const uint32_t timestamp, const uint32_t staleness_budget ) {
+        const uint32_t interval  = timestamp - last_overheard_;
+        const uint32_t deviation = interval > cadence_ ? interval - cadence_ : cadence_ - interval;
+        const bool     avoided   = deferred_ && interval >= get_poll_interval();
+
+        if( heard_ && deviation <= cadence_ / 8 ) {
+          stable_ = std::min< uint8_t >( stable_ + 1, StableCadence );
+        } else {
+          stable_ = 0;
+        }
+        cadence_        = heard_ ? interval : 0;
+        heard_          = true;
+        last_overheard_ = timestamp;
+
+        const uint32_t wait = cadence_ + cadence_ / 8;
+        deferred_           = stable_ >= StableCadence && wait > get_poll_interval() && wait <= staleness_budget;
+        if( deferred_ ) {
+          schedule_next_update( timestamp, wait );
+        }
+
+        return avoided;
+      }
+
+      // unanswered Gets are repeated at the next opportunity, after retry_count repetitions the entity waits for the retry
+      // interval
+      const BsbPacket createPackageGet( const uint8_t source_address, const uint8_t destination_address, const uint32_t timestamp ) {
+        if( deferred_ ) {
+          deferred_ = false;
+          if( timestamp - last_overheard_ >= cadence_ + cadence_ / 8 ) {
+            ESP_LOGD( TAG, "Get %08X: broadcast overdue, polling again", get_field_id() );
+            stable_ = 0;
+          }
+        }
+
+        if( ++sent_get_ > retry_count_ ) {
+          ESP_LOGW( TAG, "Get %08X: retries exhausted, waiting %.0fs before retry", get_field_id(), retry_interval_ms_ / 1000. );
+          sent_get_              = 0;
+          next_update_timestamp_ = timestamp + retry_interval_ms_;
+        } else {
+          next_update_timestamp_ = timestamp;
+        }
+        update_due();
+
+        return BsbPacketGet( source_address, destination_address, get_field_id() + request_offset_ );
+      }
+
+    protected:
+      using Decoder = void ( * )( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp );
+
+      // for value types an entity can not show: the field still counts as updated
+      static void decode_nothing( BsbEntity* entity, const BsbPacket* /* packet */, const uint32_t timestamp ) {
+        entity->schedule_next_regular_update( timestamp );
+      }
+
+      // A decoded value: the field counts as updated, the poll interval adapts to whether the value moved since the last
+      // read, and the result tells whether to publish it. Numeric values are compared with the deadbands, to the last read
+      // value for polling and to the last published one for publishing.
+      bool accept_value( const float value, const uint32_t timestamp ) {
+        const bool moved = exceeds_deadband( value, last_value_ );
+        last_value_      = value;
+
+        if( !accept_change( moved, exceeds_deadband( value, published_value_ ), timestamp ) ) {
+          return false;
+        }
+        published_value_ = value;
+        return true;
+      }
+
+      // for all other values the entity tells whether it differs from the published one; whether it moved since the last
+      // read is told by a hash of the raw value
+      bool accept_change( const uint8_t* raw, const size_t size, const bool changed, const uint32_t timestamp ) {
+        uint32_t hash = 2166136261UL; // FNV-1a
+        for( size_t i = 0; i < size; i++ ) {
+          hash = ( hash ^ raw[i] ) * 16777619UL;
+        }
+        const bool moved = hash != last_hash_;
+        last_hash_       = hash;
+        return accept_change( moved, changed, timestamp );
+      }
+
+      bool accept_change( const bool moved, const bool changed, const uint32_t timestamp ) {
+        if( is_adaptive() && heard_value_ ) {
+          const uint32_t interval = moved ? get_poll_interval() / 2 : get_poll_interval() + get_poll_interval() / 4;
+          poll_interval_ms_       = std::max( min_update_interval_ms_, std::min( interval, max_update_interval_ms_ ) );
+        }
+        heard_value_ = true;
+        schedule_next_regular_update( timestamp );
+
+        const bool confirming = confirming_;
+        confirming_           = false;
+        if( filtered_ && published_ && !confirming ) {
+          const uint32_t since     = timestamp - last_published_;
+          const bool     heartbeat = heartbeat_ms_ != 0 && since >= heartbeat_ms_;
+          if( !heartbeat && !( changed && since >= min_publish_interval_ms_ ) ) {
+            return false;
+          }
+        }
+        published_      = true;
+        last_published_ = timestamp;
+        return true;
+      }
+
+      // a value published outside of the publish filter, like a confirmed or reverted Set, counts for it all the same
+      void mark_published() {
+        published_      = true;
+        last_published_ = millis();
+      }
+      void mark_published( const float value ) {
+        published_value_ = value;
+        mark_published();
+      }
+
+      bool exceeds_deadband( const float value, const float reference ) const {
+        const float delta = std::fabs( value - reference );
+        return delta > deadband_ && delta > relative_deadband_ * std::fabs( reference );
+      }
+
+      void mark_dirty() {
+        sent_set_         = 0;
+        set_retry_cycles_ = 0;
+        set_timestamp_    = millis();
+        dirty_            = true;
+        ++edit_;
+        update_due();
+      }
+
+      // like Gets, unacknowledged Sets are repeated; after MaxSetRetryCycles rounds of them the new value is dropped and
+      // the Set is not sent again. Returns whether to send it.
+      bool sent_set( const uint32_t timestamp ) {
+        if( ++sent_set_ > retry_count_ ) {
+          sent_set_ = 0;
+          if( ++set_retry_cycles_ >= MaxSetRetryCycles ) {
+            ESP_LOGE( TAG, "Set %08X: giving up after %d retry cycles", get_field_id(), set_retry_cycles_ );
+            reset_dirty();
+            revert();
+            return false;
+          }
+          ESP_LOGW( TAG,
+                    "Set %08X: retries exhausted (cycle %d/%d), waiting %.0fs before retry",
+                    get_field_id(),
+                    set_retry_cycles_,
+                    MaxSetRetryCycles,
+                    retry_interval_ms_ / 1000. );
+          set_timestamp_ = timestamp + retry_interval_ms_;
+        } else {
+          set_timestamp_ = timestamp;
+        }
+        sent_edit_ = edit_;
+        update_due();
+        return true;
+      }
+
+      // The entity is scheduled for whichever comes first, its Set or its read. The slack orders the classes: a Set may
+      // not wait behind anything due after it, a read-back only shortly, a regular read for a quarter of its poll
+      // interval and the first read of a restored value for a whole one. Reads that waited longer go before newer Sets,
+      // so no class starves the others.
+      void update_due() {
+        const uint32_t read = polled_ ? next_update_timestamp_ : Never;
+        const uint32_t set  = dirty_ ? set_timestamp_ : Never;
+        if( set <= read ) {
+          set_due( set, SetSlack );
+        } else if( read_back_ ) {
+          set_due( read, ReadBackSlack );
+        } else if( stale_ ) {
+          set_due( read, std::max( get_poll_interval(), MinReadSlack ) );
+        } else {
+          set_due( read, std::max( get_poll_interval() / 4, MinReadSlack ) );
+        }
+      }
+
+      static constexpr uint8_t  MaxSetRetryCycles = 3;
+      static constexpr uint32_t SetSlack          = 0;
+      static constexpr uint32_t ReadBackSlack     = 1000;
+      static constexpr uint32_t MinReadSlack      = 2000;
+      // consecutive broadcast intervals that have to agree before a field is refreshed passively
+      static constexpr uint8_t StableCadence = 2;
+
+      BsbEntityKind kind_;
+      uint32_t      field_id_ = 0;
+      Decoder       decoder_  = &decode_nothing;
+
+      // entities spanning consecutive fields, like the days of a time program, poll the one they miss next
+      uint8_t request_offset_ = 0;
+
+      uint32_t update_interval_ms_     = 0;
+      uint32_t min_update_interval_ms_ = 0;
+      uint32_t max_update_interval_ms_ = 0;
+      uint32_t poll_interval_ms_       = 0;
+      uint32_t retry_interval_ms_      = 0;
+      uint8_t  retry_count_            = 0;
+
+      uint32_t next_update_timestamp_ = 0;
+      uint32_t set_timestamp_         = 0;
+
+      uint16_t sent_get_         = 0;
+      uint16_t sent_set_         = 0;
+      uint8_t  set_retry_cycles_ = 0;
+      uint8_t  edit_             = 0; // counts the edits, to tell which one a Set carried
+      uint8_t  sent_edit_        = 0;
+      bool     polled_           = true;
+      bool     dirty_            = false;
+      bool     read_back_        = false;
+      bool     optimistic_       = false;
+      bool     stale_            = false;
+
+      float    deadband_                = 0;
+      float    relative_deadband_       = 0;
+      uint32_t min_publish_interval_ms_ = 0;
+      uint32_t heartbeat_ms_            = 0;
+      uint32_t last_published_          = 0;
+      float    published_value_         = 0;
+      float    last_value_              = 0;
+      uint32_t last_hash_               = 0;
+      bool     heard_value_             = false;
+      bool     published_               = false;
+      bool     filtered_                = false;
+      bool     confirming_              = false;
+
+      uint32_t last_overheard_ = 0;
+      uint32_t cadence_        = 0;
+      uint8_t  stable_         = 0;
+      bool     heard_          = false;
+      bool     deferred_       = false;
+    };
+
+  } // namespace bsb
+} // namespace esphome
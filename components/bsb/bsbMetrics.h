@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+  namespace bsb {
+
+    // Distribution of durations in ms: exact up to 3ms, above four buckets per power of two, so percentiles are within
+    // 25% of the real value. Adding a value is a few instructions, the percentiles are only computed when read.
+    class BsbHistogram {
+    public:
+      static constexpr uint8_t Buckets = 64;
+
+      void add( const uint32_t value ) {
+        ++counts_[bucket( value )];
+        ++count_;
+        max_ = std::max( max_, value );
+      }
+
+      // the upper end of the bucket the q-th quantile (0..1) falls into, 0 if empty
+      uint32_t percentile( const float q ) const {
+        if( count_ == 0 ) {
+          return 0;
+        }
+
+        const uint32_t rank = std::max< uint32_t >( 1, ( uint32_t )( q * count_ + 0.5f ) );
+        uint32_t       sum  = 0;
+        for( uint8_t i = 0; i < Buckets; i++ ) {
+          sum += counts_[i];
+          if( sum >= rank ) {
+            return std::min( upper_bound( i ), max_ );
+          }
+        }
+        return max_;
+      }
+
+      uint32_t count() const { return count_; }
+      uint32_t max() const { return max_; }
+
+      void clear() {
+        std::memset( counts_, 0, sizeof( counts_ ) );
+        count_ = 0;
+        max_   = 0;
+      }
+
+    protected:
+      static uint8_t bucket( const uint32_t value ) {
+        if( value < 4 ) {
+          return value;
+        }
+        const uint8_t msb = 31 - __builtin_clz( value );
+        const uint8_t sub = ( value >> ( msb - 2 ) ) & 3;
+        return std::min< uint32_t >( ( msb - 1 ) * 4 + sub, Buckets - 1 );
+      }
+
+      static uint32_t upper_bound( const uint8_t bucket ) {
+        if( bucket < 4 ) {
+          return bucket;
+        }
+        const uint8_t msb = bucket / 4 + 1;
+        return ( ( 4u + bucket % 4 + 1 ) << ( msb - 2 ) ) - 1;
+      }
+
+      uint32_t counts_[Buckets] = {};
+      uint32_t count_           = 0;
+      uint32_t max_             = 0;
+    };
+
+    // What the component counts about the bus. Counters only grow, the histograms are per publish period.
+    struct BsbMetrics {
+      uint32_t bytes_in          = 0;
+      uint32_t bytes_out         = 0;
+      uint32_t frames_in         = 0;
+      uint32_t frames_out        = 0;
+      uint32_t crc_errors        = 0;
+      uint32_t framing_errors    = 0;
+      uint32_t retries           = 0;
+      uint32_t retries_exhausted = 0;
+      uint32_t nacks             = 0;
+      uint32_t timeouts          = 0;
+
+      // Get->Ret round trips, and how late polls were sent after they were due
+      BsbHistogram latency;
+      BsbHistogram scheduler_lag;
+      // how far past its deadline the latest request was sent, per publish period; 0 while no request waited longer than
+      // its class allows
+      uint32_t scheduler_overrun = 0;
+      // frames the receive task had no room for, because the main loop was blocked for too long
+      uint32_t frames_dropped    = 0;
+    };
+
+    // the values that can be published as diagnostic sensors
+    enum class BsbMetric : uint8_t {
+      BytesIn,
+      BytesOut,
+      FramesPerSecond,
+      CrcErrors,
+      FramingErrors,
+      LatencyP50,
+      LatencyP90,
+      LatencyP99,
+      Retries,
+      RetriesExhausted,
+      Nacks,
+      Timeouts,
+      SchedulerLagP90,
+      SchedulerLagMax,
+      SchedulerOverrun,
+      FramesDropped,
+      StaleValues,
+      Count
+    };
+
+  } // namespace bsb
+} // namespace esphome
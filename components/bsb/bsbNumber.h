@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cmath>
 #include <cstdint>
 
+#include "bsbEntity.h"
 #include "bsbPacket.h"
 #include "bsbPacketSend.h"
 
@@ -19,94 +21,31 @@ namespace esphome {
 
     enum class BsbNumberValueType { UInt8, Int8, Int16, Int32, Temperature, RoomTemperature };
 
-    class BsbNumberBase {
+    class BsbNumberBase : public BsbEntity {
     public:
+      BsbNumberBase() : BsbEntity( BsbEntityKind::Number ) {}
+
       virtual NumberType get_type() = 0;
 
       virtual void set_value( const float value ) = 0;
       virtual void publish()                      = 0;
 
-      void           set_field_id( const uint32_t field_id ) { this->field_id_ = field_id; }
-      const uint32_t get_field_id() const { return field_id_; }
-
-      void       set_broadcast( const bool broadcast ) { this->broadcast_ = broadcast; }
+      // broadcast numbers are only sent, never read back
+      void set_broadcast( const bool broadcast ) {
+        this->broadcast_ = broadcast;
+        set_polled( !broadcast );
+      }
       const bool get_broadcast() const { return this->broadcast_; }
 
       void set_enable_byte( const uint8_t enable_byte ) { this->enable_byte_ = enable_byte; }
 
-      void           set_update_interval( const uint32_t val ) { update_interval_ms_ = val; }
-      const uint32_t get_update_interval() const { return update_interval_ms_; }
-
-      void set_retry_interval( const uint32_t val ) { retry_interval_ms_ = val; }
-      void set_retry_count( uint8_t val ) { retry_count_ = val; }
-
       void                     set_value_type( const int type ) { this->value_type_ = ( BsbNumberValueType )type; }
       const BsbNumberValueType get_value_type() const { return this->value_type_; }
 
-      bool is_ready_to_update( const uint32_t timestamp ) {
-        if( sent_get_ >= 5 ) {
-          if( !logged_get_exhaustion_ ) {
-            ESP_LOGW( TAG, "BsbNumber Get %08X: retries exhausted, waiting %.0fs before retry", get_field_id(), retry_interval_ms_ / 1000. );
-            logged_get_exhaustion_ = true;
-            retry_get_start_timestamp_ = timestamp;
-          }
-          if( timestamp >= ( retry_get_start_timestamp_ + retry_interval_ms_ ) ) {
-            ESP_LOGI( TAG, "BsbNumber Get %08X: retrying after wait", get_field_id() );
-            sent_get_ = 0;
-            logged_get_exhaustion_ = false;
-            return true;
-          }
-          return false;
-        }
-        return !broadcast_ && timestamp >= next_update_timestamp_;
-      }
-
-      bool is_ready_to_set( const uint32_t timestamp ) {
-        if( sent_set_ >= 5 ) {
-          if( !logged_set_exhaustion_ ) {
-            set_retry_cycles_++;
-            if( set_retry_cycles_ >= 3 ) {
-              ESP_LOGE( TAG, "BsbNumber Set %08X: giving up after %d retry cycles", get_field_id(), set_retry_cycles_ );
-              dirty_ = false;
-              sent_set_ = 0;
-              set_retry_cycles_ = 0;
-              return false;
-            }
-            ESP_LOGW( TAG, "BsbNumber Set %08X: retries exhausted (cycle %d/3), waiting %.0fs before retry", get_field_id(), set_retry_cycles_, retry_interval_ms_ / 1000. );
-            logged_set_exhaustion_ = true;
-            retry_set_start_timestamp_ = timestamp;
-          }
-          if( timestamp >= ( retry_set_start_timestamp_ + retry_interval_ms_ ) ) {
-            ESP_LOGI( TAG, "BsbNumber Set %08X: retrying after wait", get_field_id() );
-            sent_set_ = 0;
-            logged_set_exhaustion_ = false;
-            return true;
-          }
-          return false;
+      const BsbPacket createPackageSet( const uint8_t source_address, const uint8_t destination_address, const uint32_t timestamp ) {
+        if( !sent_set( timestamp ) ) {
+          return BsbPacket();
         }
-        return dirty_;
-      }
-
-      void schedule_next_regular_update( const uint32_t timestamp ) {
-        sent_get_              = 0;
-        logged_get_exhaustion_ = false;
-        next_update_timestamp_ = timestamp + update_interval_ms_;
-      }
-      void schedule_next_update( const uint32_t timestamp, const uint32_t interval ) {
-        sent_get_              = 0;
-        logged_get_exhaustion_ = false;
-        next_update_timestamp_ = timestamp + interval;
-      }
-
-      void reset_dirty() {
-        sent_set_ = 0;
-        set_retry_cycles_ = 0;
-        logged_set_exhaustion_ = false;
-        dirty_    = false;
-      }
-
-      const BsbPacket createPackageSet( uint8_t source_address, uint8_t destination_address ) {
-        ++sent_set_;
 
         switch( get_value_type() ) {
           case BsbNumberValueType::UInt8: {
@@ -148,36 +87,44 @@ namespace esphome {
         }
       }
 
-      const BsbPacket createPackageGet( uint8_t source_address, uint8_t destination_address ) {
-        ++sent_get_;
-
-        return BsbPacketGet( source_address, destination_address, get_field_id() );
+      // picks Derived::decode< T > for the raw value type T of the field
+      template< typename Derived >
+      void select_decoder_of() {
+        scale_ = 1.;
+        switch( value_type_ ) {
+          case BsbNumberValueType::UInt8:
+            decoder_ = &Derived::template decode< uint8_t >;
+            break;
+          case BsbNumberValueType::Int8:
+            decoder_ = &Derived::template decode< int8_t >;
+            break;
+          case BsbNumberValueType::Int16:
+            decoder_ = &Derived::template decode< int16_t >;
+            break;
+          case BsbNumberValueType::Int32:
+            decoder_ = &Derived::template decode< int32_t >;
+            break;
+          case BsbNumberValueType::Temperature:
+            scale_   = 1. / 64;
+            decoder_ = &Derived::template decode< int16_t >;
+            break;
+          default:
+            decoder_ = &decode_nothing;
+            break;
+        }
       }
 
     protected:
       virtual const uint32_t getValueToSendUint32() const = 0;
       virtual const float    getValueToSendFloat() const  = 0;
 
+      // the raw value times scale_ is the value on the bus, 1/64 for temperatures
+      float scale_ = 1.;
+
       // uint16_t           parameterNumber_ = 0;
-      uint32_t           field_id_    = 0;
       uint8_t            enable_byte_ = 0x01;
       bool               broadcast_   = false;
       BsbNumberValueType value_type_  = BsbNumberValueType::Temperature;
-
-      uint32_t update_interval_ms_;
-      uint32_t retry_interval_ms_;
-      uint8_t  retry_count_;
-
-      uint32_t next_update_timestamp_ = 0;
-      uint32_t retry_get_start_timestamp_ = 0;
-      uint32_t retry_set_start_timestamp_ = 0;
-
-      uint16_t sent_set_ = 0;
-      uint16_t sent_get_ = 0;
-      uint8_t  set_retry_cycles_ = 0;
-      bool     dirty_    = false;
-      bool     logged_get_exhaustion_ = false;
-      bool     logged_set_exhaustion_ = false;
     };
 
     class BsbNumber
@@ -188,13 +135,32 @@ namespace esphome {
 
       virtual void control( float value ) override {
         this->state = value;
-        dirty_      = true;
+        mark_dirty();
       }
 
       void set_value( const float value ) override { publish_state( value * factor_ / divisor_ ); }
 
+      void select_decoder() override {
+        select_decoder_of< BsbNumber >();
+        scale_ *= factor_ / divisor_;
+      }
+
       void publish() override { publish_state( state ); }
 
+      void commit() override {
+        confirmed_ = state;
+        mark_published( state );
+        publish_state( state );
+      }
+      // without a value read yet, the value set is kept
+      void revert() override {
+        if( !std::isnan( confirmed_ ) ) {
+          state = confirmed_;
+          mark_published( confirmed_ );
+          publish_state( confirmed_ );
+        }
+      }
+
       void        set_divisor( const float divisor ) { this->divisor_ = divisor; }
       const float get_divisor() const { return this->divisor_; }
 
@@ -202,12 +168,27 @@ namespace esphome {
       const float get_factor() const { return this->factor_; }
 
     protected:
+      friend class BsbNumberBase;
+
+      template< typename T >
+      static void decode( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp ) {
+        BsbNumber*  number = static_cast< BsbNumber* >( entity );
+        const float value  = parse_raw< T >( packet ) * number->scale_;
+        // while a Set is pending, the state is the value to send
+        if( number->accept_value( value, timestamp ) && !number->is_dirty() ) {
+          number->publish_state( value );
+        }
+        number->confirmed_ = value;
+      }
+
       const uint32_t getValueToSendUint32() const override { return getValueToSendFloat(); }
       const float    getValueToSendFloat() const override { return state * divisor_ / factor_; }
 
       bool  broadcast_ = false;
       float divisor_   = 1.;
       float factor_    = 1.;
+      // as last read or acknowledged, NAN until then
+      float confirmed_ = NAN;
     };
 
 #ifdef USE_SWITCH
@@ -241,17 +222,48 @@ namespace esphome {
 
       virtual void write_state( bool value ) override {
         this->state = value;
-        dirty_      = true;
+        mark_dirty();
       }
 
       void set_value( const bool value ) { publish_state( value ); }
 
+      void commit() override {
+        confirmed_     = state;
+        has_confirmed_ = true;
+        mark_published( state );
+        publish_state( state );
+      }
+      void revert() override {
+        if( has_confirmed_ ) {
+          state = confirmed_;
+          mark_published( confirmed_ );
+          publish_state( confirmed_ );
+        }
+      }
+
+      void select_decoder() override { select_decoder_of< BsbSwitch >(); }
+
     protected:
+      friend class BsbNumberBase;
+
+      template< typename T >
+      static void decode( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp ) {
+        BsbSwitch* sw    = static_cast< BsbSwitch* >( entity );
+        const bool value = parse_raw< T >( packet ) * sw->scale_ != sw->off_value_;
+        if( sw->accept_value( value, timestamp ) && !sw->is_dirty() ) {
+          sw->publish_state( value );
+        }
+        sw->confirmed_     = value;
+        sw->has_confirmed_ = true;
+      }
+
       const uint32_t getValueToSendUint32() const override { return state ? on_value_ : off_value_; }
       const float    getValueToSendFloat() const override { return state ? on_value_ : off_value_; }
 
       float on_value_;
       float off_value_;
+      bool  confirmed_     = false;
+      bool  has_confirmed_ = false;
     };
 #endif
 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+  namespace bsb {
+
+    // one option of an enum field: the value on the bus and its text
+    struct BsbOption {
+      int8_t      value;
+      const char* option;
+    };
+
+    // The options of an enum field in two constant arrays generated by codegen: the options sorted by value, and their
+    // indices sorted by text (strcmp order). Both directions are a binary search over flash, nothing is copied to RAM.
+    class BsbOptionTable {
+    public:
+      void set( const BsbOption* options, const uint8_t* by_option, const uint8_t size ) {
+        options_   = options;
+        by_option_ = by_option;
+        size_      = size;
+      }
+
+      bool    empty() const { return size_ == 0; }
+      uint8_t size() const { return size_; }
+
+      // the text of value, nullptr if it has none
+      const char* find_option( const int8_t value ) const {
+        uint8_t first = 0;
+        uint8_t count = size_;
+        while( count > 0 ) {
+          const uint8_t half = count / 2;
+          if( options_[first + half].value < value ) {
+            first += half + 1;
+            count -= half + 1;
+          } else {
+            count = half;
+          }
+        }
+        return first < size_ && options_[first].value == value ? options_[first].option : nullptr;
+      }
+
+      // the value of the option text, false if there is no such option (or no index by text)
+      bool find_value( const char* option, int8_t& value ) const {
+        if( by_option_ == nullptr ) {
+          return false;
+        }
+
+        uint8_t first = 0;
+        uint8_t count = size_;
+        while( count > 0 ) {
+          const uint8_t half = count / 2;
+          if( std::strcmp( options_[by_option_[first + half]].option, option ) < 0 ) {
+            first += half + 1;
+            count -= half + 1;
+          } else {
+            count = half;
+          }
+        }
+        if( first < size_ && std::strcmp( options_[by_option_[first]].option, option ) == 0 ) {
+          value = options_[by_option_[first]].value;
+          return true;
+        }
+        return false;
+      }
+
+    protected:
+      const BsbOption* options_   = nullptr;
+      const uint8_t*   by_option_ = nullptr;
+      uint8_t          size_      = 0;
+    };
+
+  } // namespace bsb
+} // namespace esphome
@@ -3,9 +3,9 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <string>
-#include <vector>
 
 #include "esphome/core/helpers.h"
 
@@ -13,16 +13,119 @@
 
 namespace esphome {
   namespace bsb {
+    // lookup table for CRC-16/XMODEM (poly 0x1021, init 0), generated at compile time. Each lookup processes Bits bits of
+    // input: Bits = 8 gives a 512 byte table and one lookup per byte, Bits = 4 a 32 byte table and two lookups per byte.
+    template< uint8_t Bits >
+    class BsbCrcTable {
+    public:
+      static constexpr uint16_t Entries = 1 << Bits;
+
+      constexpr BsbCrcTable() : table() {
+        for( uint16_t i = 0; i < Entries; i++ ) {
+          uint16_t crc = i << ( 16 - Bits );
+          for( uint8_t j = 0; j < Bits; j++ ) {
+            crc = ( crc & 0x8000 ) ? ( ( crc << 1 ) ^ 0x1021 ) : ( crc << 1 );
+          }
+          table[i] = crc;
+        }
+      }
+
+      constexpr uint16_t update( uint16_t crc, uint8_t chunk ) const {
+        return ( uint16_t )( crc << Bits ) ^ table[( ( crc >> ( 16 - Bits ) ) ^ chunk ) & ( Entries - 1 )];
+      }
+
+      uint16_t table[Entries];
+    };
+
+#ifdef BSB_CRC_TABLE_SMALL
+    using BsbCrc = BsbCrcTable< 4 >;
+#else
+    using BsbCrc = BsbCrcTable< 8 >;
+#endif
+
+    // the bus is inverted relative to the UART, flip all bits of a block in place. Works on whole words where possible.
+    inline void invert_bytes( uint8_t* data, size_t len ) {
+      size_t i = 0;
+      for( ; i + sizeof( uint32_t ) <= len; i += sizeof( uint32_t ) ) {
+        uint32_t word;
+        std::memcpy( &word, data + i, sizeof( word ) );
+        word = ~word;
+        std::memcpy( data + i, &word, sizeof( word ) );
+      }
+      for( ; i < len; i++ ) {
+        data[i] ^= 0xff;
+      }
+    }
+
+    // fixed capacity byte buffer, stored inline so packets can be passed around by value without touching the heap
+    template< uint8_t Capacity >
+    class BsbBuffer {
+    public:
+      void clear() { size_ = 0; }
+
+      bool push_back( const uint8_t data ) {
+        if( size_ >= Capacity ) {
+          return false;
+        }
+        data_[size_++] = data;
+        return true;
+      }
+
+      void resize( const uint8_t size ) { size_ = std::min( size, Capacity ); }
+
+      uint8_t                  size() const { return size_; }
+      bool                     empty() const { return size_ == 0; }
+      static constexpr uint8_t capacity() { return Capacity; }
+
+      uint8_t*       data() { return data_; }
+      const uint8_t* data() const { return data_; }
+
+      uint8_t&       operator[]( const uint8_t i ) { return data_[i]; }
+      const uint8_t& operator[]( const uint8_t i ) const { return data_[i]; }
+
+      uint8_t*       begin() { return data_; }
+      uint8_t*       end() { return data_ + size_; }
+      const uint8_t* begin() const { return data_; }
+      const uint8_t* end() const { return data_ + size_; }
+      const uint8_t* cbegin() const { return data_; }
+      const uint8_t* cend() const { return data_ + size_; }
+
+    private:
+      uint8_t data_[Capacity] = {};
+      uint8_t size_           = 0;
+    };
+
+    // non-owning view of some bytes, e.g. the payload inside a frame
+    class BsbBufferView {
+    public:
+      BsbBufferView( const uint8_t* data, const uint8_t size ) : data_( data ), size_( size ) {}
+
+      uint8_t size() const { return size_; }
+      bool    empty() const { return size_ == 0; }
+
+      const uint8_t* data() const { return data_; }
+
+      const uint8_t& operator[]( const uint8_t i ) const { return data_[i]; }
+      const uint8_t& front() const { return data_[0]; }
+      const uint8_t& back() const { return data_[size_ - 1]; }
+
+      const uint8_t* begin() const { return data_; }
+      const uint8_t* end() const { return data_ + size_; }
+      const uint8_t* cbegin() const { return data_; }
+      const uint8_t* cend() const { return data_ + size_; }
+
+    private:
+      const uint8_t* data_;
+      uint8_t        size_;
+    };
+
     class BsbPacket {
     public:
       enum class Command : uint8_t { None = 0, Inf = 2, Set = 3, Ack = 4, Nack = 5, Get = 6, Ret = 7 };
 
-      BsbPacket() {
-        buffer.reserve( 32 );
-        payload.reserve( 16 );
-      }
+      BsbPacket() {}
 
-      static uint16_t CRC( const std::vector< uint8_t >::const_iterator& begin, const std::vector< uint8_t >::const_iterator& end ) {
+      static uint16_t CRC( const uint8_t* begin, const uint8_t* end ) {
         uint16_t crc = 0;
 
         std::for_each( begin, end, [&crc]( const uint8_t& b ) { crc = crc_xmodem_update( crc, b ); } );
@@ -31,46 +134,46 @@ namespace esphome {
       }
 
       static uint16_t crc_xmodem_update( uint16_t crc, uint8_t data ) {
-        crc = crc ^ ( ( uint16_t )data << 8 );
-        for( uint8_t i = 0; i < 8; i++ ) {
-          if( crc & 0x8000 ) {
-            crc = ( crc << 1 ) ^ 0x1021;
-          } else {
-            crc <<= 1;
-          }
-        }
-        return crc;
+#ifdef BSB_CRC_TABLE_SMALL
+        crc = crc_table.update( crc, data >> 4 );
+        return crc_table.update( crc, data & 0x0F );
+#else
+        return crc_table.update( crc, data );
+#endif
       }
 
-      std::string print_packet() const {
-        std::string output;
-        output = "BSB Packet: ";
-
-        char str[100];
-
+      // the name of a command, nullptr for unknown ones
+      static const char* command_name( const Command command ) {
         switch( command ) {
           case Command::Inf:
-            output += "Inf";
-            break;
+            return "Inf";
           case Command::Set:
-            output += "Set";
-            break;
+            return "Set";
           case Command::Ack:
-            output += "Ack";
-            break;
+            return "Ack";
           case Command::Nack:
-            output += "Nack";
-            break;
+            return "Nack";
           case Command::Get:
-            output += "Get";
-            break;
+            return "Get";
           case Command::Ret:
-            output += "Ret";
-            break;
+            return "Ret";
           default:
-            snprintf( str, 100, "UNK (%02hhX)", ( uint8_t )command );
-            output += str;
-            break;
+            return nullptr;
+        }
+      }
+
+      std::string print_packet() const {
+        std::string output;
+        output = "BSB Packet: ";
+
+        char str[100];
+
+        const char* name = command_name( command );
+        if( name != nullptr ) {
+          output += name;
+        } else {
+          snprintf( str, 100, "UNK (%02hhX)", ( uint8_t )command );
+          output += str;
         }
 
         snprintf( str, 100, " %02hhX->%02hhX, len: %2hhu", sourceAddress, destinationAddress, lenght );
@@ -79,73 +182,73 @@ namespace esphome {
         snprintf( str, 100, ", field: %08X, CRC: %04hX", fieldId, crc );
         output += str;
 
-        if( payload.size() ) {
+        if( payloadSize ) {
           output += ", payload: ";
-          output += format_hex_pretty( payload );
+          output += format_hex_pretty( payload().data(), payloadSize );
         }
 
         output += " (";
-        output += esphome::format_hex_pretty( buffer );
+        output += esphome::format_hex_pretty( buffer.data(), buffer.size() );
         output += ") ";
 
         return output;
       }
 
       int8_t parse_as_int8() const {
-        if( payload.size() != 2 ) {
+        if( payloadSize != 2 ) {
           return 0;
         }
 
-        return payload.back();
+        return payload().back();
       }
 
       uint8_t parse_as_uint8() const {
-        if( payload.size() != 2 ) {
+        if( payloadSize != 2 ) {
           return 0;
         }
 
-        return payload.back();
+        return payload().back();
       }
 
       int16_t parse_as_int16() const {
-        if( payload.size() != 3 ) {
+        if( payloadSize != 3 ) {
           return 0;
         }
 
-        return payload[1] << 8 | payload[2];
+        return payload()[1] << 8 | payload()[2];
       }
 
       float parse_as_temperature() const { return parse_as_int16() / 64.; }
 
       int32_t parse_as_int32() const {
-        if( payload.size() != 5 ) {
+        if( payloadSize != 5 ) {
           return 0;
         }
 
-        return payload[1] << 24 | payload[2] << 16 | payload[3] << 8 | payload[4];
+        return payload()[1] << 24 | payload()[2] << 16 | payload()[3] << 8 | payload()[4];
       }
 
-      std::string parse_as_text() const { return std::string( payload.cbegin(), payload.cend() ); }
+      std::string parse_as_text() const { return std::string( payload().cbegin(), payload().cend() ); }
 
       std::string parse_as_time() const {
-        if( payload.size() != 3 ) {
+        if( payloadSize != 3 ) {
           return "";
         }
 
-        uint8_t flag = payload.front();
+        uint8_t flag = payload().front();
 
         if( flag == 0x01 ) {
           return "00:00";
         } else {
           char str[10];
-          snprintf( str, 10, "%02u:%02u", payload[1], payload[2] );
+          snprintf( str, 10, "%02u:%02u", payload()[1], payload()[2] );
 
           return str;
         }
       }
 
       std::string parse_as_schedule() const {
-        if( payload.size() != 12 ) {
+        if( payloadSize != 12 ) {
           return "";
         }
 
@@ -153,18 +256,18 @@ namespace esphome {
         snprintf( str,
                   100,
                   "%02u:%02u-%02u:%02u %02u:%02u-%02u:%02u %02u:%02u-%02u:%02u",
-                  payload[0],
-                  payload[1],
-                  payload[2],
-                  payload[3],
-                  payload[4],
-                  payload[5],
-                  payload[6],
-                  payload[7],
-                  payload[8],
-                  payload[9],
-                  payload[10],
-                  payload[11] );
+                  payload()[0],
+                  payload()[1],
+                  payload()[2],
+                  payload()[3],
+                  payload()[4],
+                  payload()[5],
+                  payload()[6],
+                  payload()[7],
+                  payload()[8],
+                  payload()[9],
+                  payload()[10],
+                  payload()[11] );
 
         return str;
       }
@@ -179,67 +282,80 @@ namespace esphome {
         // Byte 5: hour
         // Byte 6: minute
         // Byte 7: second
-        if( payload.size() != 9 ) {
+        if( payloadSize != 9 ) {
           return "";
         }
 
-        uint8_t flag = payload[0];
+        uint8_t flag = payload()[0];
         if( flag != 0x00 ) {
           return "---";
         }
 
         char str[25];
         snprintf( str, 25, "%02u.%02u.%04u %02u:%02u:%02u",
-                  payload[3],           // day
-                  payload[2],           // month
-                  payload[1] + 1900,    // year
-                  payload[5],           // hour
-                  payload[6],           // minute
-                  payload[7] );         // second
+                  payload()[3],         // day
+                  payload()[2],         // month
+                  payload()[1] + 1900,  // year
+                  payload()[5],         // hour
+                  payload()[6],         // minute
+                  payload()[7] );       // second
 
         return str;
       }
 
+      BsbBufferView payload() const { return BsbBufferView( buffer.data() + PayloadOffset, payloadSize ); }
+
+      // the payload is written directly into its place in the frame, create_packet() then adds header and CRC around it
+      void add_payload( const uint8_t data ) {
+        if( PayloadOffset + payloadSize < MaxPacketSize - 2 ) {
+          buffer[PayloadOffset + payloadSize++] = data;
+        }
+      }
+
+      void clear_payload() { payloadSize = 0; }
+
       void create_packet() {
-        buffer.clear();
-        lenght = PacketSizeWithoutPyload + payload.size();
+        lenght = PacketSizeWithoutPyload + payloadSize;
+        buffer.resize( lenght );
 
-        buffer.push_back( 0xDC );
-        buffer.push_back( sourceAddress | 0x80 );
-        buffer.push_back( destinationAddress );
-        buffer.push_back( lenght );
-        buffer.push_back( ( uint8_t )command );
+        buffer[0] = 0xDC;
+        buffer[1] = sourceAddress | 0x80;
+        buffer[2] = destinationAddress;
+        buffer[3] = lenght;
+        buffer[4] = ( uint8_t )command;
 
         if( command == Command::Get || command == Command::Set || command == Command::Inf ) {
           // beware: to send the first two bytes have to be swapped
-          buffer.push_back( ( fieldId >> 16 ) & 0xFF );
-          buffer.push_back( ( fieldId >> 24 ) & 0xFF );
+          buffer[5] = ( fieldId >> 16 ) & 0xFF;
+          buffer[6] = ( fieldId >> 24 ) & 0xFF;
         } else {
-          buffer.push_back( ( fieldId >> 24 ) & 0xFF );
-          buffer.push_back( ( fieldId >> 16 ) & 0xFF );
+          buffer[5] = ( fieldId >> 24 ) & 0xFF;
+          buffer[6] = ( fieldId >> 16 ) & 0xFF;
         }
 
-        buffer.push_back( ( fieldId >> 8 ) & 0xFF );
-        buffer.push_back( ( fieldId ) & 0xFF );
-        buffer.insert( buffer.end(), payload.cbegin(), payload.cend() );
+        buffer[7] = ( fieldId >> 8 ) & 0xFF;
+        buffer[8] = ( fieldId ) & 0xFF;
 
-        crc = CRC( buffer.cbegin(), buffer.cend() );
-        buffer.push_back( ( crc >> 8 ) & 0xFF );
-        buffer.push_back( ( crc ) & 0xFF );
-
-        lenght = buffer.size();
+        crc = CRC( buffer.cbegin(), buffer.cbegin() + PayloadOffset + payloadSize );
+        buffer[lenght - 2] = ( crc >> 8 ) & 0xFF;
+        buffer[lenght - 1] = ( crc ) & 0xFF;
       }
 
-      std::vector< uint8_t > buffer;
-      uint8_t                sourceAddress;
-      uint8_t                destinationAddress;
-      uint8_t                lenght;
-      Command                command;
-      uint32_t               fieldId;
-      std::vector< uint8_t > payload;
-      uint16_t               crc;
+      static constexpr uint8_t MaxPacketSize = 32;
+      static constexpr uint8_t PayloadOffset = 9;
+
+      BsbBuffer< MaxPacketSize > buffer;
+      uint8_t                    sourceAddress;
+      uint8_t                    destinationAddress;
+      uint8_t                    lenght;
+      Command                    command;
+      uint32_t                   fieldId;
+      uint8_t                    payloadSize = 0;
+      uint16_t                   crc;
 
       static constexpr uint8_t PacketSizeWithoutPyload = 11;
+
+      static constexpr BsbCrc crc_table {};
     };
   }
 }
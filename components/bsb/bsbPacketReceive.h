@@ -6,7 +6,6 @@
 
 #include <functional>
 #include <string>
-#include <vector>
 
 #include "esphome/core/helpers.h"
 
@@ -22,71 +21,103 @@ namespace esphome {
 
       BsbPacketReceive() = delete;
 
+      // called with frames that were received completely, but with a wrong CRC
+      void set_crc_error_callback( std::function< void( const BsbPacket* ) > callback ) { crc_error_callback = callback; }
+
+      // complete frames with a wrong CRC, frames abandoned after the start byte because of an invalid header, and bytes
+      // outside of frames
+      uint32_t get_crc_errors() const { return crcErrors; }
+      uint32_t get_resyncs() const { return resyncs; }
+      uint32_t get_skipped_bytes() const { return skippedBytes; }
+
+      void loop( const uint8_t* data, const size_t len ) {
+        for( size_t i = 0; i < len; i++ ) {
+          loop( data[i] );
+        }
+      }
+
+      // true between frames, false while a frame is being received
+      bool is_idle() const { return state == ProtocolStates::Start; }
+
       void loop( const uint8_t data ) {
         switch( state ) {
           case ProtocolStates::Start:
             buffer.clear();
+            crcRunning = 0;
 
             if( data == 0xDC ) {
-              buffer.push_back( data );
+              push( data );
               state = ProtocolStates::SourceAddr;
+            } else {
+              ++skippedBytes;
             }
             break;
 
           case ProtocolStates::SourceAddr:
             if( data & 0x80 ) {
-              buffer.push_back( data );
+              push( data );
               sourceAddress = data & 0x7F;
               state         = ProtocolStates::DestAddr;
             } else {
+              ++resyncs;
               state = ProtocolStates::Start;
             }
             break;
 
           case ProtocolStates::DestAddr:
-            buffer.push_back( data );
+            push( data );
             destinationAddress = data;
             state              = ProtocolStates::Lenght;
             break;
 
           case ProtocolStates::Lenght:
-            buffer.push_back( data );
-            lenght = data;
-            state  = ProtocolStates::Type;
+            if( data >= PacketSizeWithoutPyload && data <= MaxPacketSize ) {
+              push( data );
+              lenght = data;
+              state  = ProtocolStates::Type;
+            } else {
+              ++resyncs;
+              state = ProtocolStates::Start;
+            }
             break;
 
           case ProtocolStates::Type:
-            buffer.push_back( data );
+            push( data );
             command = ( Command )data;
             state   = ProtocolStates::FieldId1;
             break;
 
           case ProtocolStates::FieldId1:
-            buffer.push_back( data );
+            push( data );
             fieldId = data << 24;
 
             state = ProtocolStates::FieldId2;
             break;
 
           case ProtocolStates::FieldId2:
-            buffer.push_back( data );
+            push( data );
             fieldId |= data << 16;
 
             state = ProtocolStates::FieldId3;
             break;
 
           case ProtocolStates::FieldId3:
-            buffer.push_back( data );
+            push( data );
             fieldId |= data << 8;
 
             state = ProtocolStates::FieldId4;
             break;
 
           case ProtocolStates::FieldId4:
-            buffer.push_back( data );
+            push( data );
             fieldId |= data;
 
-            payload.clear();
+            if( command == Command::Get || command == Command::Set || command == Command::Inf ) {
+              // the first two bytes are swapped on the bus, see create_packet()
+              fieldId = ( ( fieldId & 0x00FF0000 ) << 8 ) | ( ( fieldId & 0xFF000000 ) >> 8 ) | ( fieldId & 0xFFFF );
+            }
+
+            payloadSize = 0;
 
             if( lenght > PacketSizeWithoutPyload ) {
               state = ProtocolStates::Payload;
@@ -96,9 +127,9 @@ namespace esphome {
             break;
 
           case ProtocolStates::Payload:
-            buffer.push_back( data );
-            payload.push_back( data );
-            if( payload.size() == ( lenght - PacketSizeWithoutPyload ) ) {
+            push( data );
+            ++payloadSize;
+            if( payloadSize == ( lenght - PacketSizeWithoutPyload ) ) {
               state = ProtocolStates::CRC1;
             }
 
@@ -117,10 +148,13 @@ namespace esphome {
 
             crc |= data;
 
-            uint16_t crcCalculated = CRC( buffer.cbegin(), buffer.cend() - 2 );
-
-            if( crc == crcCalculated ) {
+            if( crc == crcRunning ) {
               callback( this );
+            } else {
+              ++crcErrors;
+              if( crc_error_callback ) {
+                crc_error_callback( this );
+              }
             }
 
             state = ProtocolStates::Start;
@@ -129,7 +163,20 @@ namespace esphome {
       }
 
     private:
+      // the CRC is calculated as the bytes come in, so it is ready to compare as soon as the frame is complete
+      void push( const uint8_t data ) {
+        buffer.push_back( data );
+        crcRunning = crc_xmodem_update( crcRunning, data );
+      }
+
       std::function< void( const BsbPacket* ) > callback;
+      std::function< void( const BsbPacket* ) > crc_error_callback;
+
+      uint16_t crcRunning = 0;
+
+      uint32_t crcErrors    = 0;
+      uint32_t resyncs      = 0;
+      uint32_t skippedBytes = 0;
 
       ProtocolStates state = ProtocolStates::Start;
     };
@@ -6,7 +6,6 @@
 
 #include <functional>
 #include <string>
-#include <vector>
 
 #include "esphome/core/helpers.h"
 
@@ -36,12 +35,12 @@ namespace esphome {
                          const uint8_t  enable_byte )
           : BsbPacketSet( sourceAddress, destinationAddress, fieldId ) {
         if( enable_byte == 0x06 && value == 0. ) {
-          payload.push_back( 0x05 );
+          add_payload( 0x05 );
         } else {
-          payload.push_back( enable_byte );
+          add_payload( enable_byte );
         }
 
-        payload.push_back( value );
+        add_payload( value );
 
         create_packet();
       }
@@ -58,12 +57,12 @@ namespace esphome {
                         const uint8_t  enable_byte )
           : BsbPacketSet( sourceAddress, destinationAddress, fieldId ) {
         if( enable_byte == 0x06 && value == 0. ) {
-          payload.push_back( 0x05 );
+          add_payload( 0x05 );
         } else {
-          payload.push_back( enable_byte );
+          add_payload( enable_byte );
         }
 
-        payload.push_back( value );
+        add_payload( value );
 
         create_packet();
       }
@@ -80,13 +79,13 @@ namespace esphome {
                          const uint8_t  enable_byte )
           : BsbPacketSet( sourceAddress, destinationAddress, fieldId ) {
         if( enable_byte == 0x06 && value == 0. ) {
-          payload.push_back( 0x05 );
+          add_payload( 0x05 );
         } else {
-          payload.push_back( enable_byte );
+          add_payload( enable_byte );
         }
 
-        payload.push_back( value >> 8 );
-        payload.push_back( value );
+        add_payload( value >> 8 );
+        add_payload( value );
 
         create_packet();
       }
@@ -103,15 +102,15 @@ namespace esphome {
                          const uint8_t  enable_byte )
           : BsbPacketSet( sourceAddress, destinationAddress, fieldId ) {
         if( enable_byte == 0x06 && value == 0. ) {
-          payload.push_back( 0x05 );
+          add_payload( 0x05 );
         } else {
-          payload.push_back( enable_byte );
+          add_payload( enable_byte );
         }
 
-        payload.push_back( value >> 24 );
-        payload.push_back( value >> 16 );
-        payload.push_back( value >> 8 );
-        payload.push_back( value );
+        add_payload( value >> 24 );
+        add_payload( value >> 16 );
+        add_payload( value >> 8 );
+        add_payload( value );
 
         create_packet();
       }
@@ -151,9 +150,9 @@ namespace esphome {
       BsbPacketInfTemperature( const uint8_t sourceAddress, const uint32_t fieldId, const float value, const uint8_t enable_byte = 0x01 )
           : BsbPacketInf( sourceAddress, fieldId ) {
         int16_t val = value * 64.;
-        payload.push_back( enable_byte );
-        payload.push_back( val >> 8 );
-        payload.push_back( val );
+        add_payload( enable_byte );
+        add_payload( val >> 8 );
+        add_payload( val );
 
         create_packet();
       }
@@ -166,9 +165,9 @@ namespace esphome {
       BsbPacketInfRoomTemperature( const uint8_t sourceAddress, const uint32_t fieldId, const float value, const uint8_t enable_byte )
           : BsbPacketInf( sourceAddress, fieldId ) {
         int16_t val = value * 64.;
-        payload.push_back( val >> 8 );
-        payload.push_back( val );
-        payload.push_back( 0 );
+        add_payload( val >> 8 );
+        add_payload( val );
+        add_payload( 0 );
 
         create_packet();
       }
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/components/uart/uart.h"
+#include "esphome/core/hal.h"
+
+#include "bsbPacket.h"
+#include "bsbPacketReceive.h"
+
+#ifdef USE_ESP32
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+  #include <freertos/task.h>
+#else
+  #include <thread>
+#endif
+
+namespace esphome {
+  namespace bsb {
+
+    // Lock-free ring for one producer and one consumer thread. Each side only writes its own index, the release store of
+    // the index publishes the slot to the other side. Size has to be a power of two, the indices run freely and wrap.
+    template< typename T, uint32_t Size >
+    class BsbSpscQueue {
+      static_assert( Size != 0 && ( Size & ( Size - 1 ) ) == 0, "Size has to be a power of two" );
+
+    public:
+      // producer: the slot to fill next, nullptr while the queue is full; push() makes it visible
+      T* back() {
+        const uint32_t tail = tail_.load( std::memory_order_relaxed );
+        if( tail - head_.load( std::memory_order_acquire ) == Size ) {
+          return nullptr;
+        }
+        return &items_[tail & ( Size - 1 )];
+      }
+      void push() { tail_.store( tail_.load( std::memory_order_relaxed ) + 1, std::memory_order_release ); }
+
+      // consumer: the oldest item, nullptr while the queue is empty; pop() hands its slot back
+      const T* front() const {
+        const uint32_t head = head_.load( std::memory_order_relaxed );
+        if( head == tail_.load( std::memory_order_acquire ) ) {
+          return nullptr;
+        }
+        return &items_[head & ( Size - 1 )];
+      }
+      void pop() { head_.store( head_.load( std::memory_order_relaxed ) + 1, std::memory_order_release ); }
+
+    private:
+      T                       items_[Size];
+      std::atomic< uint32_t > head_ { 0 };
+      std::atomic< uint32_t > tail_ { 0 };
+    };
+
+    // a frame as received, with a correct CRC or not
+    struct BsbReceivedFrame {
+      BsbPacket packet;
+      uint32_t  received_us;
+      bool      crc_ok;
+    };
+
+    // Drains the UART in its own task, a FreeRTOS task on the ESP32 and a thread on the host, and runs the receive state
+    // machine there. Complete frames are handed to loop() through a lock-free queue, so frames keep being received while
+    // the main loop is blocked by other components, e.g. by a Wi-Fi reconnect or an OTA update. The main loop only writes
+    // to the UART from then on, the task is the only reader.
+    class BsbReceiveTask {
+    public:
+      // frames kept while the main loop is blocked, 3.5kB; at most about 40 frames per second fit on the bus, usually
+      // there are far less
+      static constexpr uint32_t QueueSize = 64;
+
+      explicit BsbReceiveTask( uart::UARTDevice* uart )
+          : uart_( uart ), receive_( [this]( const BsbPacket* packet ) { queue( packet, true ); } ) {
+        receive_.set_crc_error_callback( [this]( const BsbPacket* packet ) { queue( packet, false ); } );
+      }
+
+      BsbReceiveTask( const BsbReceiveTask& )            = delete;
+      BsbReceiveTask& operator=( const BsbReceiveTask& ) = delete;
+
+      ~BsbReceiveTask() { stop(); }
+
+      void start() {
+        running_.store( true, std::memory_order_relaxed );
+#ifdef USE_ESP32
+        exited_ = xSemaphoreCreateBinary();
+        // above the main loop, so the task runs as soon as bytes are waiting
+        if( xTaskCreate( &BsbReceiveTask::task, "bsb_receive", 3072, this, 5, &handle_ ) != pdPASS ) {
+          handle_ = nullptr;
+        }
+#else
+        thread_ = std::thread( [this]() { run(); } );
+#endif
+      }
+
+      void stop() {
+        running_.store( false, std::memory_order_relaxed );
+#ifdef USE_ESP32
+        // the task deletes itself once it sees running_ cleared, and signals when it no longer uses this object
+        if( handle_ != nullptr ) {
+          xSemaphoreTake( exited_, portMAX_DELAY );
+          handle_ = nullptr;
+        }
+        if( exited_ != nullptr ) {
+          vSemaphoreDelete( exited_ );
+          exited_ = nullptr;
+        }
+#else
+        if( thread_.joinable() ) {
+          thread_.join();
+        }
+#endif
+      }
+
+      // consumer side, called by loop()
+      const BsbReceivedFrame* front() const { return frames_.front(); }
+      void                    pop() { frames_.pop(); }
+
+      // the state of the receiver as of the last block it got; updated by the task, read by loop()
+      uint32_t get_bytes() const { return bytes_.load( std::memory_order_relaxed ); }
+      uint32_t get_resyncs() const { return resyncs_.load( std::memory_order_relaxed ); }
+      uint32_t get_dropped() const { return dropped_.load( std::memory_order_relaxed ); }
+      uint32_t get_last_receive_us() const { return last_receive_us_.load( std::memory_order_relaxed ); }
+      bool     is_idle() const { return idle_.load( std::memory_order_relaxed ); }
+
+    protected:
+#ifdef USE_ESP32
+      static void task( void* arg ) {
+        BsbReceiveTask* receive_task = static_cast< BsbReceiveTask* >( arg );
+        receive_task->run();
+        xSemaphoreGive( receive_task->exited_ );
+        vTaskDelete( nullptr );
+      }
+#endif
+
+      void run() {
+        uint8_t block[BlockSize];
+        while( running_.load( std::memory_order_relaxed ) ) {
+          int available = uart_->available();
+          if( available <= 0 ) {
+            wait();
+            continue;
+          }
+
+          const size_t len = std::min( ( size_t )available, sizeof( block ) );
+          if( !uart_->read_array( block, len ) ) {
+            wait();
+            continue;
+          }
+          invert_bytes( block, len );
+          received_us_ = micros();
+          receive_.loop( block, len );
+
+          bytes_.store( bytes_.load( std::memory_order_relaxed ) + len, std::memory_order_relaxed );
+          resyncs_.store( receive_.get_resyncs(), std::memory_order_relaxed );
+          last_receive_us_.store( received_us_, std::memory_order_relaxed );
+          idle_.store( receive_.is_idle(), std::memory_order_relaxed );
+        }
+      }
+
+      // one tick (1ms with ESPHome), about 2 bytes at 4800 baud, far less than the UART buffers. A whole tick also on the
+      // ESP32, where delay() of less than a tick only yields and would starve the tasks of lower priority.
+      static void wait() {
+#ifdef USE_ESP32
+        vTaskDelay( 1 );
+#else
+        delay( 1 );
+#endif
+      }
+
+      // a frame that does not fit is dropped, the ones queued before it are not touched by the consumer yet
+      void queue( const BsbPacket* packet, const bool crc_ok ) {
+        BsbReceivedFrame* frame = frames_.back();
+        if( frame == nullptr ) {
+          dropped_.store( dropped_.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+          return;
+        }
+        frame->packet      = *packet;
+        frame->received_us = received_us_;
+        frame->crc_ok      = crc_ok;
+        frames_.push();
+      }
+
+      static constexpr size_t BlockSize = 32;
+
+      uart::UARTDevice* uart_;
+      BsbPacketReceive  receive_;
+      uint32_t          received_us_ = 0;
+
+      BsbSpscQueue< BsbReceivedFrame, QueueSize > frames_;
+
+      std::atomic< bool >     running_ { false };
+      std::atomic< uint32_t > bytes_ { 0 };
+      std::atomic< uint32_t > resyncs_ { 0 };
+      std::atomic< uint32_t > dropped_ { 0 };
+      std::atomic< uint32_t > last_receive_us_ { 0 };
+      std::atomic< bool >     idle_ { true };
+
+#ifdef USE_ESP32
+      TaskHandle_t      handle_ = nullptr;
+      SemaphoreHandle_t exited_ = nullptr;
+#else
+      std::thread thread_;
+#endif
+    };
+
+  } // namespace bsb
+} // namespace esphome
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace esphome {
+  namespace bsb {
+    class BsbScheduler;
+
+    // something the scheduler keeps in order: from its due time on it may be sent, and among all items that may be sent,
+    // the one with the earliest deadline goes first
+    class BsbSchedulerItem {
+    public:
+      static constexpr uint32_t Never = UINT32_MAX;
+
+      uint32_t get_due() const { return due_; }
+      uint32_t get_deadline() const { return deadline_; }
+
+    protected:
+      // changes the due time, the item may wait for slack behind items that are due later; the scheduler is updated in
+      // place
+      inline void set_due( const uint32_t due, const uint32_t slack );
+
+    private:
+      friend class BsbScheduler;
+
+      static constexpr uint16_t NotScheduled = UINT16_MAX;
+
+      uint32_t      due_        = 0;
+      uint32_t      deadline_   = 0;
+      uint16_t      heap_index_ = NotScheduled;
+      bool          released_   = false;
+      BsbScheduler* scheduler_  = nullptr;
+    };
+
+    // Earliest deadline first among the items that are due. Items wait in a binary min-heap by due time until release()
+    // moves them to a second one by deadline, whose top is sent next. Each item knows its position in its heap, so
+    // finding the next item is O(1) and changing the due time of an item is O(log n), without searching for it.
+    //
+    // The slack makes the classes of requests age against each other: an item is sent before any item due after its
+    // deadline, so it waits at most for its slack plus the items with an earlier deadline, however many are due later.
+    class BsbScheduler {
+    public:
+      void add( BsbSchedulerItem* item ) {
+        if( item->scheduler_ == this ) {
+          return;
+        }
+        item->scheduler_ = this;
+        push( waiting_, item, false );
+      }
+
+      void update( BsbSchedulerItem* item ) {
+        if( item->scheduler_ != this ) {
+          return;
+        }
+        // whether the new due time has come is decided by the next release()
+        if( item->released_ ) {
+          remove( released_, item );
+          push( waiting_, item, false );
+        } else {
+          restore( waiting_, item->heap_index_ );
+        }
+      }
+
+      // makes all items that are due by now eligible
+      void release( const uint32_t now ) {
+        while( !waiting_.empty() && waiting_.front()->due_ <= now ) {
+          BsbSchedulerItem* item = waiting_.front();
+          remove( waiting_, item );
+          push( released_, item, true );
+        }
+      }
+
+      // the due item with the earliest deadline, as of the last release()
+      BsbSchedulerItem* top() const { return released_.empty() ? nullptr : released_.front(); }
+      size_t            size() const { return waiting_.size() + released_.size(); }
+
+    protected:
+      using Heap = std::vector< BsbSchedulerItem* >;
+
+      // waiting items are ordered by due time, released ones by deadline
+      static uint32_t key( const Heap& heap, const size_t index ) {
+        return heap[index]->released_ ? heap[index]->deadline_ : heap[index]->due_;
+      }
+
+      void push( Heap& heap, BsbSchedulerItem* item, const bool released ) {
+        item->released_   = released;
+        item->heap_index_ = heap.size();
+        heap.push_back( item );
+        sift_up( heap, item->heap_index_ );
+      }
+
+      void remove( Heap& heap, BsbSchedulerItem* item ) {
+        const size_t index = item->heap_index_;
+        swap( heap, index, heap.size() - 1 );
+        heap.pop_back();
+        item->heap_index_ = BsbSchedulerItem::NotScheduled;
+        if( index < heap.size() ) {
+          restore( heap, index );
+        }
+      }
+
+      void restore( Heap& heap, const size_t index ) { sift_down( heap, sift_up( heap, index ) ); }
+
+      size_t sift_up( Heap& heap, size_t index ) {
+        while( index > 0 ) {
+          size_t parent = ( index - 1 ) / 2;
+          if( key( heap, parent ) <= key( heap, index ) ) {
+            break;
+          }
+          swap( heap, index, parent );
+          index = parent;
+        }
+        return index;
+      }
+
+      size_t sift_down( Heap& heap, size_t index ) {
+        while( true ) {
+          size_t smallest = index;
+          size_t left     = 2 * index + 1;
+          size_t right    = left + 1;
+          if( left < heap.size() && key( heap, left ) < key( heap, smallest ) ) {
+            smallest = left;
+          }
+          if( right < heap.size() && key( heap, right ) < key( heap, smallest ) ) {
+            smallest = right;
+          }
+          if( smallest == index ) {
+            return index;
+          }
+          swap( heap, index, smallest );
+          index = smallest;
+        }
+      }
+
+      static void swap( Heap& heap, const size_t a, const size_t b ) {
+        std::swap( heap[a], heap[b] );
+        heap[a]->heap_index_ = a;
+        heap[b]->heap_index_ = b;
+      }
+
+      Heap waiting_;
+      Heap released_;
+    };
+
+    void BsbSchedulerItem::set_due( const uint32_t due, const uint32_t slack ) {
+      due_      = due;
+      deadline_ = due > Never - slack ? Never : due + slack;
+      if( scheduler_ != nullptr ) {
+        scheduler_->update( this );
+      }
+    }
+
+  } // namespace bsb
+} // namespace esphome
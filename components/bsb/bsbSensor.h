@@ -1,8 +1,9 @@
 #pragma once
 
-#include <map>
 #include <string>
 
+#include "bsbEntity.h"
+#include "bsbOptions.h"
 #include "bsbPacketSend.h"
 
 #include "esphome/components/sensor/sensor.h"
@@ -22,67 +23,18 @@ namespace esphome {
 
     enum class BsbSensorValueType { UInt8, Int8, Int16, Int32, Temperature, RoomTemperature, DateTime };
 
-    class BsbSensorBase {
+    class BsbSensorBase : public BsbEntity {
     public:
+      BsbSensorBase() : BsbEntity( BsbEntityKind::Sensor ) {}
+
       virtual SensorType get_type() = 0;
       virtual void       publish()  = 0;
 
-      void           set_field_id( const uint32_t field_id ) { this->field_id_ = field_id; }
-      const uint32_t get_field_id() const { return field_id_; }
-
-      void           set_update_interval( const uint32_t update_interval_ms ) { update_interval_ms_ = update_interval_ms; }
-      const uint32_t get_update_interval() const { return update_interval_ms_; }
-
-      void set_retry_interval( const uint32_t retry_interval_ms ) { retry_interval_ms_ = retry_interval_ms; }
-      void set_retry_count( uint8_t retry_count ) { retry_count_ = retry_count; }
-
       void                     set_value_type( const int value_type ) { this->value_type_ = ( BsbSensorValueType )value_type; }
       const BsbSensorValueType get_value_type() const { return this->value_type_; }
 
-      const bool is_ready( const uint32_t timestamp ) {
-        if( sent_get_ >= 5 ) {
-          if( !logged_exhaustion_ ) {
-            ESP_LOGW( TAG, "BsbSensor Get %08X: retries exhausted, waiting %.0fs before retry", get_field_id(), retry_interval_ms_ / 1000. );
-            logged_exhaustion_ = true;
-            retry_start_timestamp_ = timestamp;
-          }
-          if( timestamp >= ( retry_start_timestamp_ + retry_interval_ms_ ) ) {
-            ESP_LOGI( TAG, "BsbSensor Get %08X: retrying after wait", get_field_id() );
-            sent_get_ = 0;
-            logged_exhaustion_ = false;
-            return true;
-          }
-          return false;
-        }
-
-        return timestamp >= next_update_timestamp_;
-      }
-
-      void schedule_next_regular_update( const uint32_t timestamp ) {
-        sent_get_              = 0;
-        logged_exhaustion_     = false;
-        next_update_timestamp_ = timestamp + update_interval_ms_;
-      }
-
-      const BsbPacket createPackageGet( uint8_t source_address, uint8_t destination_address ) {
-        ++sent_get_;
-
-        return BsbPacketGet( source_address, destination_address, get_field_id() );
-      }
-
     protected:
-      uint32_t           field_id_;
       BsbSensorValueType value_type_ = BsbSensorValueType::Temperature;
-
-      uint32_t update_interval_ms_;
-      uint32_t retry_interval_ms_;
-      uint8_t  retry_count_;
-
-    private:
-      uint32_t next_update_timestamp_ = 0;
-      uint32_t retry_start_timestamp_ = 0;
-      uint16_t sent_get_              = 0;
-      bool     logged_exhaustion_     = false;
     };
 
     class BsbSensor
@@ -96,6 +48,32 @@ namespace esphome {
 
       void set_value( float value ) { this->value_ = value * factor_ / divisor_; }
 
+      // factor, divisor and the 1/64 of temperatures are folded into one multiplication
+      void select_decoder() override {
+        scale_ = factor_ / divisor_;
+        switch( value_type_ ) {
+          case BsbSensorValueType::UInt8:
+            decoder_ = &decode< uint8_t >;
+            break;
+          case BsbSensorValueType::Int8:
+            decoder_ = &decode< int8_t >;
+            break;
+          case BsbSensorValueType::Int16:
+            decoder_ = &decode< int16_t >;
+            break;
+          case BsbSensorValueType::Int32:
+            decoder_ = &decode< int32_t >;
+            break;
+          case BsbSensorValueType::Temperature:
+            scale_ /= 64;
+            decoder_ = &decode< int16_t >;
+            break;
+          default:
+            decoder_ = &decode_nothing;
+            break;
+        }
+      }
+
       void        set_divisor( const float divisor ) { this->divisor_ = divisor; }
       const float get_divisor() const { return this->divisor_; }
 
@@ -103,8 +81,18 @@ namespace esphome {
       const float get_factor() const { return this->factor_; }
 
     protected:
+      template< typename T >
+      static void decode( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp ) {
+        BsbSensor* sensor = static_cast< BsbSensor* >( entity );
+        sensor->value_ = parse_raw< T >( packet ) * sensor->scale_;
+        if( sensor->accept_value( sensor->value_, timestamp ) ) {
+          sensor->publish_state( sensor->value_ );
+        }
+      }
+
       float   divisor_     = 1.;
       float   factor_      = 1.;
+      float   scale_       = 1.;
       uint8_t enable_byte_ = 0x01;
 
       float value_;
@@ -121,23 +109,39 @@ namespace esphome {
       void set_value( const std::string value ) { this->value_ = value; }
 
       void set_value_int( int8_t value ) {
-        auto it = value_to_option_.find(value);
-        if (it != value_to_option_.end()) {
-          this->value_ = it->second;
+        const char* option = options_.find_option(value);
+        if (option != nullptr) {
+          this->value_ = option;
         } else {
           this->value_ = std::to_string(value);
         }
       }
 
-      void add_option_mapping( int8_t value, const std::string& option ) {
-        value_to_option_[value] = option;
-      }
+      // the option table generated by codegen; only looked up by value, so without the index by text
+      void set_options( const BsbOption* options, const uint8_t size ) { options_.set( options, nullptr, size ); }
 
-      bool has_enum_mapping() const { return !value_to_option_.empty(); }
+      bool has_enum_mapping() const { return !options_.empty(); }
+
+      void select_decoder() override { decoder_ = &decode; }
 
     protected:
+      static void decode( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp ) {
+        BsbTextSensor* sensor = static_cast< BsbTextSensor* >( entity );
+        if( sensor->get_value_type() == BsbSensorValueType::DateTime ) {
+          sensor->set_value( packet->parse_as_datetime() );
+        } else if( sensor->has_enum_mapping() ) {
+          sensor->set_value_int( packet->parse_as_int8() );
+        } else {
+          sensor->set_value( packet->parse_as_text() );
+        }
+        if( sensor->accept_change(
+              packet->payload().data(), packet->payloadSize, !sensor->has_state() || sensor->value_ != sensor->state, timestamp ) ) {
+          sensor->publish();
+        }
+      }
+
       std::string value_;
-      std::map<int8_t, std::string> value_to_option_;
+      BsbOptionTable options_;
     };
 #endif
 
@@ -163,7 +167,20 @@ namespace esphome {
       void          set_off_value( const uint8_t off_value ) { this->off_value_ = off_value; }
       const uint8_t get_off_value() const { return this->off_value_; }
 
+      void select_decoder() override { decoder_ = &decode; }
+
     protected:
+      static void decode( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp ) {
+        BsbBinarySensor* sensor = static_cast< BsbBinarySensor* >( entity );
+        // BSB on/off values are always byte-sized; use uint8_t to avoid
+        // sign extension of 0xFF (which BSB-LAN documents as a valid "on" value).
+        sensor->set_value( packet->parse_as_uint8() );
+        if( sensor->accept_change(
+              packet->payload().data(), packet->payloadSize, !sensor->has_state() || sensor->value_ != sensor->state, timestamp ) ) {
+          sensor->publish();
+        }
+      }
+
       uint8_t on_value_    = 1;
       uint8_t off_value_   = 0;
       uint8_t enable_byte_ = 0x01;
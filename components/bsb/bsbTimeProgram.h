@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "bsbEntity.h"
+#include "bsbPacket.h"
+#include "bsbPacketSend.h"
+
+#ifdef USE_TEXT
+  #include "esphome/components/text/text.h"
+#endif
+
+namespace esphome {
+  namespace bsb {
+    extern const char* const TAG;
+
+    // A time program is one field per weekday, Monday first. Each day holds three switching phases of on and off
+    // hour:minute, an unused phase has the high bit set in its hours.
+    static constexpr uint8_t TimeProgramDays     = 7;
+    static constexpr uint8_t TimeProgramDayBytes = 12;
+    static constexpr uint8_t TimeProgramUnused   = 0x80;
+
+    // "06:00-08:00 17:00-22:00", unused phases left out; out needs TimeProgramDayChars
+    static constexpr size_t TimeProgramDayChars = 48;
+
+    inline void format_time_program_day( const uint8_t* day, char* out ) {
+      size_t len = 0;
+      out[0]     = '\0';
+      for( uint8_t i = 0; i < TimeProgramDayBytes; i += 4 ) {
+        if( day[i] >= 24 ) {
+          continue;
+        }
+        len += std::snprintf( out + len,
+                              TimeProgramDayChars - len,
+                              len == 0 ? "%02u:%02u-%02u:%02u" : " %02u:%02u-%02u:%02u",
+                              day[i],
+                              day[i + 1],
+                              day[i + 2],
+                              day[i + 3] );
+      }
+    }
+
+    // the phases of one day up to the end of text or the next ';', separated by spaces or commas. Accepts up to three
+    // phases "HH:MM-HH:MM" that end after they start, at 24:00 the latest.
+    inline bool parse_time_program_day( const char*& text, uint8_t* day ) {
+      uint8_t phases = 0;
+      while( true ) {
+        while( *text == ' ' || *text == ',' ) {
+          ++text;
+        }
+        if( *text == '\0' || *text == ';' ) {
+          break;
+        }
+
+        unsigned on_hour, on_minute, off_hour, off_minute;
+        int      len = 0;
+        if( phases == 3 || std::sscanf( text, "%2u:%2u-%2u:%2u%n", &on_hour, &on_minute, &off_hour, &off_minute, &len ) != 4 ||
+            len == 0 ) {
+          return false;
+        }
+        const unsigned on  = on_hour * 60 + on_minute;
+        const unsigned off = off_hour * 60 + off_minute;
+        if( on_minute >= 60 || off_minute >= 60 || on >= off || off > 24 * 60 ) {
+          return false;
+        }
+
+        uint8_t* phase = day + phases++ * 4;
+        phase[0]       = on_hour;
+        phase[1]       = on_minute;
+        phase[2]       = off_hour;
+        phase[3]       = off_minute;
+        text += len;
+      }
+
+      for( ; phases < 3; phases++ ) {
+        uint8_t* phase = day + phases * 4;
+        phase[0]       = TimeProgramUnused;
+        phase[1]       = 0;
+        phase[2]       = TimeProgramUnused;
+        phase[3]       = 0;
+      }
+      return true;
+    }
+
+    // a week as the days separated by ';', Monday first
+    inline std::string format_time_program( const uint8_t ( *days )[TimeProgramDayBytes] ) {
+      std::string week;
+      char        day[TimeProgramDayChars];
+      for( uint8_t i = 0; i < TimeProgramDays; i++ ) {
+        format_time_program_day( days[i], day );
+        if( i != 0 ) {
+          week += ';';
+        }
+        week += day;
+      }
+      return week;
+    }
+
+    inline bool parse_time_program( const char* text, uint8_t ( *days )[TimeProgramDayBytes] ) {
+      for( uint8_t i = 0; i < TimeProgramDays; i++ ) {
+        if( !parse_time_program_day( text, days[i] ) ) {
+          return false;
+        }
+        if( i + 1 < TimeProgramDays ) {
+          if( *text != ';' ) {
+            return false;
+          }
+          ++text;
+        }
+      }
+      return *text == '\0';
+    }
+
+    class BsbPacketSetTimeProgram : public BsbPacketSet {
+    public:
+      BsbPacketSetTimeProgram( const uint8_t  sourceAddress,
+                               const uint8_t  destinationAddress,
+                               const uint32_t fieldId,
+                               const uint8_t* day )
+          : BsbPacketSet( sourceAddress, destinationAddress, fieldId ) {
+        for( uint8_t i = 0; i < TimeProgramDayBytes; i++ ) {
+          add_payload( day[i] );
+        }
+
+        create_packet();
+      }
+
+      BsbPacketSetTimeProgram() = delete;
+    };
+
+#ifdef USE_TEXT
+    // The weekly time program of a heating circuit as one text entity. A refresh fetches all seven days back to back,
+    // ahead of every other poll, and publishes the week once all of them arrived, so it never shows a mix of old and new
+    // days. An edit only sends the days that differ from what the controller has.
+    class BsbTimeProgram
+        : public text::Text
+        , public BsbEntity {
+    public:
+      BsbTimeProgram() : BsbEntity( BsbEntityKind::TimeProgram ) {}
+
+      // field_id is the field of Monday, Tuesday to Sunday follow it
+      uint32_t get_day_field_id( const uint8_t day ) const { return get_field_id() + day; }
+
+      void select_decoder() override { decoder_ = &decode; }
+
+      // one Set per changed day, Monday first
+      const BsbPacket createPackageSet( const uint8_t source_address, const uint8_t destination_address, const uint32_t timestamp ) {
+        const uint8_t day = __builtin_ctz( dirty_days_ | 1 << TimeProgramDays );
+        if( !sent_set( timestamp ) ) {
+          return BsbPacket();
+        }
+        return BsbPacketSetTimeProgram( source_address, destination_address, get_day_field_id( day ), days_to_send_[day] );
+      }
+
+      // The Ack or Nack of the Set of one day. Once all days are answered, only the accepted ones are read back, the
+      // others did not change; optimistic time programs publish the week as acknowledged right away.
+      void acknowledged( const uint32_t field_id, const bool accepted, const uint32_t timestamp ) {
+        const uint32_t day = field_id - get_field_id();
+        if( day >= TimeProgramDays || !( dirty_days_ & 1 << day ) || !is_latest_edit_sent() ) {
+          return;
+        }
+
+        dirty_days_ &= ~( 1 << day );
+        if( accepted ) {
+          std::memcpy( days_[day], days_to_send_[day], TimeProgramDayBytes );
+          written_days_ |= 1 << day;
+        } else {
+          ESP_LOGW( TAG, "BsbTimeProgram %08X: day %u refused, keeping it", get_field_id(), day );
+        }
+
+        if( dirty_days_ != 0 ) {
+          mark_dirty();
+          return;
+        }
+        reset_dirty();
+
+        // without a complete week read, the read that follows the first Set fetches all of it
+        if( !complete_ ) {
+          expect_confirmation();
+          schedule_read_back( timestamp, 0 );
+        } else if( is_optimistic() || written_days_ == 0 ) {
+          mark_published();
+          publish_state( format_time_program( days_ ) );
+        } else {
+          fresh_days_     = AllDays & ~written_days_;
+          request_offset_ = __builtin_ctz( ~fresh_days_ );
+          expect_confirmation();
+          schedule_read_back( timestamp, 0 );
+        }
+        written_days_ = 0;
+      }
+
+      void revert() override {
+        dirty_days_   = 0;
+        written_days_ = 0;
+        if( complete_ ) {
+          mark_published();
+          publish_state( format_time_program( days_ ) );
+        }
+      }
+
+      void control( const std::string& value ) override {
+        uint8_t week[TimeProgramDays][TimeProgramDayBytes];
+        if( !parse_time_program( value.c_str(), week ) ) {
+          ESP_LOGW( TAG, "BsbTimeProgram %08X: invalid time program '%s'", get_field_id(), value.c_str() );
+          return;
+        }
+
+        // a later edit replaces the days not sent yet; the day of a Set still unanswered is sent again, as its answer
+        // will be ignored and the controller may have taken the older value
+        uint8_t changed = dirty_ && sent_set_ != 0 ? dirty_days_ & -dirty_days_ : 0;
+        for( uint8_t day = 0; day < TimeProgramDays; day++ ) {
+          if( !complete_ || std::memcmp( week[day], days_[day], TimeProgramDayBytes ) != 0 ) {
+            changed |= 1 << day;
+          }
+        }
+        std::memcpy( days_to_send_, week, sizeof( week ) );
+        dirty_days_ = changed;
+        if( changed != 0 ) {
+          mark_dirty();
+        } else if( dirty_ ) {
+          reset_dirty();
+        }
+
+        publish_state( format_time_program( week ) );
+      }
+
+    protected:
+      static constexpr uint8_t AllDays = ( 1 << TimeProgramDays ) - 1;
+
+      static void decode( BsbEntity* entity, const BsbPacket* packet, const uint32_t timestamp ) {
+        BsbTimeProgram* program = static_cast< BsbTimeProgram* >( entity );
+        const uint32_t  day     = packet->fieldId - program->get_field_id();
+        if( day >= TimeProgramDays ) {
+          return;
+        }
+
+        if( packet->payloadSize != TimeProgramDayBytes ) {
+          ESP_LOGW( TAG, "BsbTimeProgram %08X: day %u has %u bytes", program->get_field_id(), day, packet->payloadSize );
+          program->fresh_days_     = 0;
+          program->request_offset_ = 0;
+          program->schedule_next_regular_update( timestamp );
+          return;
+        }
+
+        uint8_t* phases = program->days_[day];
+        std::memcpy( phases, packet->payload().data(), TimeProgramDayBytes );
+        for( uint8_t i = 0; i < TimeProgramDayBytes; i += 4 ) {
+          if( phases[i] >= 24 ) {
+            phases[i]     = TimeProgramUnused;
+            phases[i + 1] = 0;
+            phases[i + 2] = TimeProgramUnused;
+            phases[i + 3] = 0;
+          }
+        }
+
+        // A day broadcast by itself, or read by another device like a room unit, updates a known week right away. Only
+        // the answer to our own Get, while nothing else of the week is fresh, starts a refresh of the other days.
+        const bool refreshing = program->fresh_days_ != 0 || program->sent_get_ != 0;
+        if( program->complete_ && !refreshing ) {
+          program->publish_week( timestamp );
+          return;
+        }
+
+        program->fresh_days_ |= 1 << day;
+        if( program->fresh_days_ != AllDays ) {
+          // the rest of the week is fetched next, its deadline is before everything else
+          program->request_offset_ = __builtin_ctz( ~program->fresh_days_ );
+          program->schedule_read_back( 0, 0 );
+          return;
+        }
+
+        program->fresh_days_     = 0;
+        program->request_offset_ = 0;
+        program->complete_       = true;
+        program->publish_week( timestamp );
+      }
+
+      void publish_week( const uint32_t timestamp ) {
+        std::string week = format_time_program( days_ );
+        if( accept_change( &days_[0][0], sizeof( days_ ), week != state, timestamp ) ) {
+          publish_state( week );
+        }
+      }
+
+      // as last read from or acknowledged by the controller
+      uint8_t days_[TimeProgramDays][TimeProgramDayBytes]         = {};
+      uint8_t days_to_send_[TimeProgramDays][TimeProgramDayBytes] = {};
+
+      uint8_t fresh_days_   = 0; // received in the current refresh
+      uint8_t dirty_days_   = 0; // still to be sent
+      uint8_t written_days_ = 0; // acknowledged in the current edit
+      bool    complete_     = false;
+    };
+#endif
+
+  } // namespace bsb
+} // namespace esphome
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bsbPacket.h"
+
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+  #include "esphome/core/helpers.h"
+#endif
+
+namespace esphome {
+  namespace bsb {
+
+    enum class BsbTraceDirection : uint8_t { Receive, Transmit };
+
+    // one frame as it was on the bus (already flipped), with the time it was received or sent
+    struct BsbTraceRecord {
+      // flags: the CRC of the frame was correct
+      static constexpr uint8_t CrcOk = 0x01;
+
+      uint64_t          timestamp_us;
+      BsbTraceDirection direction;
+      uint8_t           flags;
+      uint8_t           size;
+      uint8_t           data[BsbPacket::MaxPacketSize];
+    };
+
+    // The last Capacity frames on the bus. Recording is a copy into a fixed ring of records, nothing is formatted until
+    // a record is read with format_trace_record(). With the capture endpoint, the web server reads the trace from its
+    // own task; it holds get_lock() while doing so, which keeps record() from changing the records it reads.
+    template< size_t Capacity >
+    class BsbTrace {
+      static_assert( Capacity > 0 && ( Capacity & ( Capacity - 1 ) ) == 0, "the trace size has to be a power of two" );
+
+    public:
+      // timestamp_us is micros(), the trace extends it to 64 bits as it wraps every 71 minutes. Frames from the receive
+      // task are timestamped before loop() records them, so one may be older than the frame before it, by as long as
+      // loop() was blocked; a timestamp up to MaxLateUs behind the last one is such a frame, not a wrap.
+      void record( const BsbTraceDirection direction,
+                   const uint8_t           flags,
+                   const uint32_t          timestamp_us,
+                   const uint8_t*          data,
+                   const size_t            size ) {
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+        LockGuard guard( lock_ );
+#endif
+        uint32_t       wraps = timestamp_wraps_;
+        const uint32_t late  = last_timestamp_us_ - timestamp_us;
+        if( total_ != 0 && late != 0 && late <= MaxLateUs ) {
+          if( timestamp_us > last_timestamp_us_ && wraps != 0 ) {
+            // from before the last wrap
+            --wraps;
+          }
+        } else {
+          if( timestamp_us < last_timestamp_us_ ) {
+            wraps = ++timestamp_wraps_;
+          }
+          last_timestamp_us_ = timestamp_us;
+        }
+
+        BsbTraceRecord& record = records_[total_ & ( Capacity - 1 )];
+        record.timestamp_us    = ( uint64_t )wraps << 32 | timestamp_us;
+        record.direction       = direction;
+        record.flags           = flags;
+        record.size            = std::min< size_t >( size, BsbPacket::MaxPacketSize );
+        std::memcpy( record.data, data, record.size );
+        ++total_;
+      }
+
+      // frames in the trace, and the number of frames recorded overall
+      size_t   size() const { return std::min< uint32_t >( total_, Capacity ); }
+      uint32_t get_total() const { return total_; }
+
+      // the i-th oldest frame in the trace
+      const BsbTraceRecord& operator[]( const size_t i ) const { return records_[( total_ - size() + i ) & ( Capacity - 1 )]; }
+
+      void clear() { total_ = 0; }
+
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+      Mutex& get_lock() const { return lock_; }
+#endif
+
+    protected:
+      static constexpr uint32_t MaxLateUs = 300000000; // 5 minutes
+
+      BsbTraceRecord records_[Capacity];
+      uint32_t       total_             = 0;
+      uint32_t       last_timestamp_us_ = 0;
+      uint32_t       timestamp_wraps_   = 0;
+#ifdef USE_BSB_CAPTURE_ENDPOINT
+      mutable Mutex lock_;
+#endif
+    };
+
+    // formats a record into out, like the packet debug log; returns the length of the text
+    inline size_t format_trace_record( const BsbTraceRecord& record, char* out, const size_t len ) {
+      int pos = snprintf( out,
+                          len,
+                          "%u.%06u %s",
+                          ( unsigned )( record.timestamp_us / 1000000 ),
+                          ( unsigned )( record.timestamp_us % 1000000 ),
+                          record.direction == BsbTraceDirection::Receive ? "<<<" : ">>>" );
+
+      if( record.size >= BsbPacket::PayloadOffset ) {
+        const uint8_t* d       = record.data;
+        const auto     command = ( BsbPacket::Command )d[4];
+        const bool     swapped = command == BsbPacket::Command::Get || command == BsbPacket::Command::Set || command == BsbPacket::Command::Inf;
+        const uint32_t field_id =
+          ( swapped ? ( d[6] << 24 | d[5] << 16 ) : ( d[5] << 24 | d[6] << 16 ) ) | d[7] << 8 | d[8];
+        const char* name = BsbPacket::command_name( command );
+
+        pos += snprintf( out + std::min< size_t >( pos, len ),
+                         len - std::min< size_t >( pos, len ),
+                         " %s %02X->%02X %08X",
+                         name != nullptr ? name : "UNK",
+                         d[1] & 0x7F,
+                         d[2],
+                         ( unsigned )field_id );
+      }
+
+      for( uint8_t i = 0; i < record.size && ( size_t )pos + 3 < len; i++ ) {
+        pos += snprintf( out + pos, len - pos, i == 0 ? " (%02X" : ".%02X", record.data[i] );
+      }
+      if( record.size && ( size_t )pos + 1 < len ) {
+        out[pos++] = ')';
+        out[pos]   = '\0';
+      }
+      if( !( record.flags & BsbTraceRecord::CrcOk ) && ( size_t )pos < len ) {
+        pos += snprintf( out + pos, len - pos, " CRC error" );
+      }
+
+      return std::min< size_t >( pos, len ? len - 1 : 0 );
+    }
+
+    // The trace as a pcap file (https://www.tcpdump.org/manpages/pcap-savefile.5.html), link type USER0. The data of each
+    // pcap record is the direction (0 received, 1 sent) and the flags of the trace record, followed by the frame.
+    namespace pcap {
+      static constexpr uint32_t Magic          = 0xA1B2C3D4; // microsecond timestamps
+      static constexpr uint32_t LinkTypeUser0  = 147;
+      static constexpr size_t   HeaderSize     = 24;
+      static constexpr size_t   RecordOverhead = 16 + 2;
+
+      inline uint8_t* put32( uint8_t* out, const uint32_t value ) {
+        for( int i = 0; i < 4; i++ ) {
+          *out++ = ( value >> ( 8 * i ) ) & 0xFF;
+        }
+        return out;
+      }
+
+      inline uint8_t* put16( uint8_t* out, const uint16_t value ) {
+        *out++ = value & 0xFF;
+        *out++ = value >> 8;
+        return out;
+      }
+    }
+
+    // Writes the trace as a pcap file piece by piece, the header and then one record at a time, to write( data, size ),
+    // so the file is never built as a whole.
+    template< size_t Capacity, typename Write >
+    void write_pcap( const BsbTrace< Capacity >& trace, Write&& write ) {
+      uint8_t  buffer[pcap::RecordOverhead + BsbPacket::MaxPacketSize];
+      uint8_t* out = buffer;
+      out          = pcap::put32( out, pcap::Magic );
+      out          = pcap::put16( out, 2 ); // version 2.4
+      out          = pcap::put16( out, 4 );
+      out          = pcap::put32( out, 0 ); // time zone and accuracy, unused
+      out          = pcap::put32( out, 0 );
+      out          = pcap::put32( out, 2 + BsbPacket::MaxPacketSize ); // snap length
+      out          = pcap::put32( out, pcap::LinkTypeUser0 );
+      write( buffer, out - buffer );
+
+      for( size_t i = 0; i < trace.size(); i++ ) {
+        const BsbTraceRecord& record = trace[i];
+        out                          = buffer;
+        out                          = pcap::put32( out, record.timestamp_us / 1000000 );
+        out                          = pcap::put32( out, record.timestamp_us % 1000000 );
+        out                          = pcap::put32( out, 2 + record.size );
+        out                          = pcap::put32( out, 2 + record.size );
+        *out++                       = ( uint8_t )record.direction;
+        *out++                       = record.flags;
+        std::memcpy( out, record.data, record.size );
+        write( buffer, out + record.size - buffer );
+      }
+    }
+
+    // the whole file, e.g. to save it on the host
+    template< size_t Capacity >
+    void export_pcap( const BsbTrace< Capacity >& trace, std::vector< uint8_t >& out ) {
+      out.clear();
+      out.reserve( pcap::HeaderSize + trace.size() * ( pcap::RecordOverhead + BsbPacket::MaxPacketSize ) );
+      write_pcap( trace, [&out]( const uint8_t* data, const size_t size ) { out.insert( out.end(), data, data + size ); } );
+    }
+
+  } // namespace bsb
+} // namespace esphome
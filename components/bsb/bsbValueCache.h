@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
+
+#include "bsbPacket.h"
+
+namespace esphome {
+  namespace bsb {
+
+    // the payload of the last Ret or Inf of a field, as it is kept in flash
+    struct BsbCachedValue {
+      static constexpr uint8_t MaxPayloadSize = BsbPacket::MaxPacketSize - BsbPacket::PacketSizeWithoutPyload;
+
+      uint8_t size = 0;
+      uint8_t payload[MaxPayloadSize];
+    };
+
+    // Keeps the last value of every field in the preferences, so the entities can publish it right after a reboot instead
+    // of waiting for the bus to get to them. Values are kept in RAM as they are received and saved together every
+    // interval, and only the ones that changed since, so the flash sees at most one write per field and interval. The
+    // preferences backend then writes them out with its own flash write interval.
+    class BsbValueCache {
+    public:
+      // one slot per field; fields have to be added in ascending order
+      void add_field( const uint32_t field_id ) {
+        if( slots_.empty() || slots_.back().field_id != field_id ) {
+          slots_.push_back( { field_id } );
+        }
+      }
+
+      // fields of different heating systems are kept apart by the address of their controller
+      void setup( const uint8_t destination_address ) {
+        char key[24];
+        for( auto& slot : slots_ ) {
+          std::snprintf( key, sizeof( key ), "bsb%02X%08X", destination_address, slot.field_id );
+          slot.preference = global_preferences->make_preference< BsbCachedValue >( fnv1_hash( key ), true );
+          if( !slot.preference.load( &slot.value ) || slot.value.size > BsbCachedValue::MaxPayloadSize ) {
+            slot.value.size = 0;
+          }
+        }
+        slots_.shrink_to_fit();
+      }
+
+      // the cached value of the field as an Inf telegram, false if there is none
+      bool restore( const uint32_t field_id, const uint8_t source_address, BsbPacket& packet ) const {
+        const Slot* slot = find( field_id );
+        if( slot == nullptr || slot->value.size == 0 ) {
+          return false;
+        }
+
+        packet.sourceAddress      = source_address;
+        packet.destinationAddress = 0x7F;
+        packet.command            = BsbPacket::Command::Inf;
+        packet.fieldId            = field_id;
+        packet.clear_payload();
+        for( uint8_t i = 0; i < slot->value.size; i++ ) {
+          packet.add_payload( slot->value.payload[i] );
+        }
+        packet.create_packet();
+        return true;
+      }
+
+      void update( const BsbPacket* packet ) {
+        Slot* slot = find( packet->fieldId );
+        if( slot == nullptr || packet->payloadSize == 0 || packet->payloadSize > BsbCachedValue::MaxPayloadSize ) {
+          return;
+        }
+        if( slot->value.size == packet->payloadSize &&
+            std::memcmp( slot->value.payload, packet->payload().data(), slot->value.size ) == 0 ) {
+          return;
+        }
+        slot->value.size = packet->payloadSize;
+        std::memcpy( slot->value.payload, packet->payload().data(), slot->value.size );
+        slot->changed = true;
+      }
+
+      // saves the values that changed since the last call, returns how many
+      uint16_t save() {
+        uint16_t saved = 0;
+        for( auto& slot : slots_ ) {
+          if( slot.changed ) {
+            slot.preference.save( &slot.value );
+            slot.changed = false;
+            ++saved;
+          }
+        }
+        return saved;
+      }
+
+      size_t size() const { return slots_.size(); }
+
+    protected:
+      struct Slot {
+        uint32_t            field_id = 0;
+        ESPPreferenceObject preference {};
+        BsbCachedValue      value {};
+        bool                changed = false;
+      };
+
+      Slot* find( const uint32_t field_id ) {
+        return const_cast< Slot* >( static_cast< const BsbValueCache* >( this )->find( field_id ) );
+      }
+      const Slot* find( const uint32_t field_id ) const {
+        auto slot = std::lower_bound( slots_.begin(), slots_.end(), field_id, []( const Slot& s, const uint32_t id ) {
+          return s.field_id < id;
+        } );
+        return slot != slots_.end() && slot->field_id == field_id ? &*slot : nullptr;
+      }
+
+      std::vector< Slot > slots_;
+    };
+
+  } // namespace bsb
+} // namespace esphome
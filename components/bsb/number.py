@@ -1,7 +1,7 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import number
-from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_BSB_TYPE_ENUM, CONF_BSB_TYPE, CONF_PARAMETER_NUMBER
+from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_BSB_TYPE_ENUM, CONF_BSB_TYPE, CONF_PARAMETER_NUMBER, DEADBAND_SCHEMA, setup_publish_filter, ADAPTIVE_POLLING_SCHEMA, validate_adaptive_polling, setup_adaptive_polling, WRITE_SCHEMA, setup_write
 
 from esphome.const import (
     CONF_ID, CONF_NAME,CONF_MAX_VALUE, CONF_MIN_VALUE, CONF_STEP, CONF_UPDATE_INTERVAL
@@ -40,8 +40,9 @@ CONFIG_SCHEMA = cv.All(
             cv.Optional(CONF_DIVISOR, default="1"): cv.float_,
             cv.Optional(CONF_FACTOR, default="1"): cv.float_,
         }
-    ),
+    ).extend(DEADBAND_SCHEMA).extend(WRITE_SCHEMA).extend(ADAPTIVE_POLLING_SCHEMA),
     cv.has_exactly_one_key(CONF_FIELD_ID),
+    validate_adaptive_polling,
 )
 
 async def to_code(config):
@@ -77,6 +78,10 @@ async def to_code(config):
     if CONF_UPDATE_INTERVAL in config:
         cg.add(var.set_update_interval(config[CONF_UPDATE_INTERVAL]))
 
+    await setup_publish_filter(var, config)
+    await setup_write(var, config)
+    await setup_adaptive_polling(var, config)
+
     cg.add(component.register_number(var))
     cg.add(var.set_retry_interval(component.get_retry_interval()))
     cg.add(var.set_retry_count(component.get_retry_count()))
@@ -1,7 +1,7 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import select
-from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_PARAMETER_NUMBER
+from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_PARAMETER_NUMBER, OPTIONS_TABLE_SCHEMA, option_table, PUBLISH_FILTER_SCHEMA, setup_publish_filter, ADAPTIVE_POLLING_SCHEMA, validate_adaptive_polling, setup_adaptive_polling, WRITE_SCHEMA, setup_write
 
 from esphome.const import (
     CONF_ID,
@@ -26,8 +26,9 @@ CONFIG_SCHEMA = cv.All(
             cv.Optional(CONF_UPDATE_INTERVAL, default="15min"): cv.update_interval,
             cv.Required(CONF_OPTIONS): cv.Schema({cv.int_: cv.string}),
         }
-    ),
+    ).extend(OPTIONS_TABLE_SCHEMA).extend(PUBLISH_FILTER_SCHEMA).extend(WRITE_SCHEMA).extend(ADAPTIVE_POLLING_SCHEMA),
     cv.has_exactly_one_key(CONF_FIELD_ID),
+    validate_adaptive_polling,
 )
 
 
@@ -48,8 +49,12 @@ async def to_code(config):
     if CONF_UPDATE_INTERVAL in config:
         cg.add(var.set_update_interval(config[CONF_UPDATE_INTERVAL]))
 
-    for value, option in options_map.items():
-        cg.add(var.add_option_mapping(value, option))
+    options, by_option, size = option_table(config, options_map)
+    cg.add(var.set_options(options, by_option, size))
+
+    await setup_publish_filter(var, config)
+    await setup_write(var, config)
+    await setup_adaptive_polling(var, config)
 
     cg.add(component.register_select(var))
     cg.add(var.set_retry_interval(component.get_retry_interval()))
@@ -1,7 +1,7 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import sensor
-from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_PARAMETER_NUMBER, CONF_BSB_TYPE_ENUM, CONF_BSB_TYPE
+from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_PARAMETER_NUMBER, CONF_BSB_TYPE_ENUM, CONF_BSB_TYPE, DEADBAND_SCHEMA, setup_publish_filter, ADAPTIVE_POLLING_SCHEMA, validate_adaptive_polling, setup_adaptive_polling
 
 from esphome.const import (
     CONF_UPDATE_INTERVAL
@@ -28,8 +28,9 @@ CONFIG_SCHEMA = cv.All(
             cv.Optional(CONF_DIVISOR, default="1"): cv.float_,
             cv.Optional(CONF_FACTOR, default="1"): cv.float_,
         }
-    ),
+    ).extend(DEADBAND_SCHEMA).extend(ADAPTIVE_POLLING_SCHEMA),
     cv.has_exactly_one_key(CONF_FIELD_ID),
+    validate_adaptive_polling,
 )
 
 
@@ -55,6 +56,9 @@ async def to_code(config):
     if CONF_UPDATE_INTERVAL in config:
         cg.add(var.set_update_interval(config[CONF_UPDATE_INTERVAL]))
 
+    await setup_publish_filter(var, config)
+    await setup_adaptive_polling(var, config)
+
     cg.add(component.register_sensor(var))
     cg.add(var.set_retry_interval(component.get_retry_interval()))
     cg.add(var.set_retry_count(component.get_retry_count()))
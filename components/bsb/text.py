@@ -0,0 +1,45 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import text
+from . import BsbComponent, bsb_ns, CONF_BSB_ID, PUBLISH_FILTER_SCHEMA, setup_publish_filter, ADAPTIVE_POLLING_SCHEMA, validate_adaptive_polling, setup_adaptive_polling, WRITE_SCHEMA, setup_write
+
+from esphome.const import (
+    CONF_UPDATE_INTERVAL,
+)
+
+CONF_FIELD_ID = "field_id"
+
+BsbTimeProgram = bsb_ns.class_("BsbTimeProgram", text.Text)
+
+CONFIG_SCHEMA = cv.All(
+    text.text_schema(
+        BsbTimeProgram,
+    ).extend(
+        {
+            cv.GenerateID(CONF_BSB_ID): cv.use_id(BsbComponent),
+            # the field of Monday, the other days follow it
+            cv.Required(CONF_FIELD_ID): cv.positive_int,
+            cv.Optional(CONF_UPDATE_INTERVAL, default="15min"): cv.update_interval,
+        }
+    ).extend(PUBLISH_FILTER_SCHEMA).extend(WRITE_SCHEMA).extend(ADAPTIVE_POLLING_SCHEMA),
+    validate_adaptive_polling,
+)
+
+
+async def to_code(config):
+    component = await cg.get_variable(config[CONF_BSB_ID])
+    # seven days of three phases "HH:MM-HH:MM" and the separators fit into 255 characters
+    var = await text.new_text(config, min_length=0, max_length=255)
+
+    cg.add(var.set_field_id(config[CONF_FIELD_ID]))
+
+    if CONF_UPDATE_INTERVAL in config:
+        cg.add(var.set_update_interval(config[CONF_UPDATE_INTERVAL]))
+
+    await setup_publish_filter(var, config)
+    await setup_write(var, config)
+    await setup_adaptive_polling(var, config)
+
+    cg.add(component.register_time_program(var))
+    cg.add(var.set_retry_interval(component.get_retry_interval()))
+    cg.add(var.set_retry_count(component.get_retry_count()))
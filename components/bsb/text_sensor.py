@@ -1,7 +1,7 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import text_sensor
-from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_PARAMETER_NUMBER, CONF_BSB_TYPE_ENUM, CONF_BSB_TYPE
+from . import BsbComponent, bsb_ns, CONF_BSB_ID, CONF_PARAMETER_NUMBER, OPTIONS_TABLE_SCHEMA, option_table, CONF_BSB_TYPE_ENUM, CONF_BSB_TYPE, PUBLISH_FILTER_SCHEMA, setup_publish_filter, ADAPTIVE_POLLING_SCHEMA, validate_adaptive_polling, setup_adaptive_polling
 
 from esphome.const import (
     CONF_OPTIONS,
@@ -24,8 +24,9 @@ CONFIG_SCHEMA = cv.All(
             cv.Optional(CONF_OPTIONS): cv.Schema({cv.int_: cv.string}),
             cv.Optional(CONF_BSB_TYPE): cv.enum(CONF_BSB_TYPE_ENUM, upper=True),
         }
-    ),
+    ).extend(OPTIONS_TABLE_SCHEMA).extend(PUBLISH_FILTER_SCHEMA).extend(ADAPTIVE_POLLING_SCHEMA),
     cv.has_exactly_one_key(CONF_FIELD_ID),
+    validate_adaptive_polling,
 )
 
 
@@ -43,8 +44,11 @@ async def to_code(config):
         cg.add(var.set_update_interval(config[CONF_UPDATE_INTERVAL]))
 
     if CONF_OPTIONS in config:
-        for value, option in config[CONF_OPTIONS].items():
-            cg.add(var.add_option_mapping(value, option))
+        options, _, size = option_table(config, config[CONF_OPTIONS], index=False)
+        cg.add(var.set_options(options, size))
+
+    await setup_publish_filter(var, config)
+    await setup_adaptive_polling(var, config)
 
     cg.add(component.register_sensor(var))
     cg.add(var.set_retry_interval(component.get_retry_interval()))
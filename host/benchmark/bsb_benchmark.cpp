@@ -0,0 +1,400 @@
+// Microbenchmarks for the per-byte and per-packet costs of the BSB component.
+//
+// Logging is compiled in at DEBUG level like on the device, but filtered at runtime, so log arguments that are
+// formatted regardless of the level show up in the numbers while printing does not.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bsb.h"
+#include "bsbPacket.h"
+#include "bsbPacketReceive.h"
+#include "bsbPacketSend.h"
+#include "host_uart.h"
+
+using namespace esphome;
+using namespace esphome::bsb;
+
+namespace {
+  const BsbOption OnOffOptions[]  = { { 0, "Off" }, { 1, "On" } };
+  const uint8_t   OnOffByOption[] = { 0, 1 };
+
+  // an enum with n options like the tables generated by codegen: sorted by value, and indices sorted by text
+  struct OptionTables {
+    explicit OptionTables( const int n ) {
+      for( int i = 0; i < n; i++ ) {
+        texts.push_back( "Option " + std::to_string( i ) );
+      }
+      for( int i = 0; i < n; i++ ) {
+        options.push_back( { ( int8_t )i, texts[i].c_str() } );
+        by_option.push_back( i );
+      }
+      std::sort( by_option.begin(), by_option.end(), [this]( uint8_t a, uint8_t b ) {
+        return std::strcmp( options[a].option, options[b].option ) < 0;
+      } );
+    }
+
+    std::vector< std::string > texts;
+    std::vector< BsbOption >   options;
+    std::vector< uint8_t >     by_option;
+  };
+
+  BsbPacket make_packet( const BsbPacket::Command command, const uint32_t fieldId, const std::vector< uint8_t >& payload ) {
+    BsbPacket packet;
+    packet.sourceAddress      = 0x00;
+    packet.destinationAddress = 0x42;
+    packet.command            = command;
+    packet.fieldId            = fieldId;
+    for( auto b : payload ) {
+      packet.add_payload( b );
+    }
+    packet.create_packet();
+    return packet;
+  }
+
+  // a mix of the telegrams seen on a typical bus, already flipped
+  std::vector< uint8_t > make_stream() {
+    std::vector< uint8_t > stream;
+
+    const BsbPacket packets[] = {
+      make_packet( BsbPacket::Command::Ret, 0x0D3D0519, { 0x00, 0x0C, 0x80 } ),
+      make_packet( BsbPacket::Command::Inf, 0x0500021F, { 0x00, 0x01, 0x40 } ),
+      make_packet( BsbPacket::Command::Ret, 0x053D0834, { 0x00, 0x32 } ),
+      make_packet( BsbPacket::Command::Ret, 0x053D3063, { 0x00, 0x05, 0xDC } ),
+      make_packet( BsbPacket::Command::Ack, 0x2D3D05F6, {} ),
+      BsbPacketGet( 0x42, 0x00, 0x2D3D0574 ),
+      make_packet( BsbPacket::Command::Ret, 0x053D0001, { 'R', 'V', 'S', '4', '3', '.', '2', '2', '3', '/', '1', '0', '0' } ),
+    };
+
+    for( const auto& packet : packets ) {
+      stream.insert( stream.end(), packet.buffer.cbegin(), packet.buffer.cend() );
+    }
+
+    return stream;
+  }
+
+  // exposes the protected parts needed to drive the component directly
+  class BenchBsbComponent : public BsbComponent {
+  public:
+    using BsbComponent::callback_packet;
+    using BsbComponent::find_entities;
+
+    BsbScheduler& get_scheduler() { return scheduler_; }
+  };
+
+  // a component with count sensors, numbers and selects on distinct field IDs, like a large configuration
+  struct Fixture {
+    explicit Fixture( const size_t count ) {
+      component.set_uart_parent( &uart );
+      component.set_query_interval( 50 );
+      component.set_request_timeout( 500 );
+      component.set_retry_interval( 15000 );
+      component.set_retry_count( 3 );
+      component.set_source_address( 0x42 );
+      component.set_destination_address( 0x00 );
+
+      for( size_t i = 0; i < count; i++ ) {
+        auto sensor = std::make_unique< BsbSensor >();
+        sensor->set_field_id( 0x053D0000 + i );
+        sensor->set_value_type( ( int )BsbSensorValueType::Temperature );
+        sensor->set_update_interval( 60000 );
+        component.register_sensor( sensor.get() );
+        sensors.push_back( std::move( sensor ) );
+
+        auto number = std::make_unique< BsbNumber >();
+        number->set_field_id( 0x2D3D0000 + i );
+        number->set_value_type( ( int )BsbNumberValueType::Int16 );
+        number->set_update_interval( 60000 );
+        component.register_number( number.get() );
+        numbers.push_back( std::move( number ) );
+
+        auto select = std::make_unique< BsbSelect >();
+        select->set_field_id( 0x2E3E0000 + i );
+        select->set_update_interval( 60000 );
+        select->set_options( OnOffOptions, OnOffByOption, 2 );
+        component.register_select( select.get() );
+        selects.push_back( std::move( select ) );
+      }
+
+      component.setup();
+    }
+
+    host::MemoryUARTComponent                   uart;
+    BenchBsbComponent                           component;
+    std::vector< std::unique_ptr< BsbSensor > > sensors;
+    std::vector< std::unique_ptr< BsbNumber > > numbers;
+    std::vector< std::unique_ptr< BsbSelect > > selects;
+  };
+
+  // hides a value from the optimizer, so the encoders are not folded into constants
+  template< typename T >
+  T opaque( T value ) {
+    benchmark::DoNotOptimize( value );
+    return value;
+  }
+
+  struct QuietLog {
+    QuietLog() { host_log_level = ESPHOME_LOG_LEVEL_NONE; }
+  } quiet_log;
+}
+
+template< uint8_t Bits >
+static void BM_Crc( benchmark::State& state ) {
+  static constexpr BsbCrcTable< Bits > table {};
+  const auto                           stream = make_stream();
+
+  for( auto _ : state ) {
+    uint16_t crc = 0;
+    for( auto b : stream ) {
+      if( Bits == 8 ) {
+        crc = table.update( crc, b );
+      } else {
+        crc = table.update( crc, b >> 4 );
+        crc = table.update( crc, b & 0x0F );
+      }
+    }
+    benchmark::DoNotOptimize( crc );
+  }
+  state.SetBytesProcessed( state.iterations() * stream.size() );
+}
+BENCHMARK_TEMPLATE( BM_Crc, 8 );
+BENCHMARK_TEMPLATE( BM_Crc, 4 );
+
+static void BM_InvertBytes( benchmark::State& state ) {
+  auto stream = make_stream();
+
+  for( auto _ : state ) {
+    invert_bytes( stream.data(), stream.size() );
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed( state.iterations() * stream.size() );
+}
+BENCHMARK( BM_InvertBytes );
+
+static void BM_ReceiveByteByByte( benchmark::State& state ) {
+  const auto       stream  = make_stream();
+  size_t           packets = 0;
+  BsbPacketReceive receive( [&]( const BsbPacket* ) { ++packets; } );
+
+  for( auto _ : state ) {
+    for( auto b : stream ) {
+      receive.loop( b );
+    }
+  }
+  benchmark::DoNotOptimize( packets );
+  state.SetBytesProcessed( state.iterations() * stream.size() );
+  state.SetItemsProcessed( packets );
+}
+BENCHMARK( BM_ReceiveByteByByte );
+
+static void BM_ReceiveBlock( benchmark::State& state ) {
+  const auto       stream  = make_stream();
+  size_t           packets = 0;
+  BsbPacketReceive receive( [&]( const BsbPacket* ) { ++packets; } );
+
+  for( auto _ : state ) {
+    receive.loop( stream.data(), stream.size() );
+  }
+  benchmark::DoNotOptimize( packets );
+  state.SetBytesProcessed( state.iterations() * stream.size() );
+  state.SetItemsProcessed( packets );
+}
+BENCHMARK( BM_ReceiveBlock );
+
+// the whole receive path of BsbComponent::loop(): UART, inversion, state machine and dispatch
+static void BM_ComponentLoopReceive( benchmark::State& state ) {
+  Fixture fixture( state.range( 0 ) );
+  auto    stream = make_stream();
+  invert_bytes( stream.data(), stream.size() );
+  fixture.uart.push_rx( stream );
+  // nothing is due, so loop() only receives
+  fixture.component.set_query_interval( UINT32_MAX );
+
+  for( auto _ : state ) {
+    fixture.uart.rewind_rx();
+    fixture.component.loop();
+  }
+  state.SetBytesProcessed( state.iterations() * stream.size() );
+}
+BENCHMARK( BM_ComponentLoopReceive )->Arg( 10 )->Arg( 150 );
+
+// one poll tick: find the entity that is due next and reschedule it after its Get
+static void BM_SchedulerNextPoll( benchmark::State& state ) {
+  Fixture  fixture( state.range( 0 ) );
+  uint32_t now = 0;
+
+  for( auto _ : state ) {
+    BsbScheduler& scheduler = fixture.component.get_scheduler();
+    scheduler.release( now );
+    BsbEntity* entity = static_cast< BsbEntity* >( scheduler.top() );
+    if( entity != nullptr ) {
+      entity->schedule_next_update( now, 1000 + ( now * 7919 ) % 60000 );
+    }
+    now += 250;
+  }
+}
+BENCHMARK( BM_SchedulerNextPoll )->Arg( 10 )->Arg( 150 );
+
+static void BM_EncodeGet( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketGet packet( 0x42, 0x00, opaque( 0x053D0000 ) );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeGet );
+
+static void BM_EncodeSetUInt8( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketSetUInt8 packet( 0x42, 0x00, 0x2D3D0574, opaque( 3 ), 0x01 );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeSetUInt8 );
+
+static void BM_EncodeSetInt8( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketSetInt8 packet( 0x42, 0x00, 0x2D3D0574, opaque( -3 ), 0x01 );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeSetInt8 );
+
+static void BM_EncodeSetInt16( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketSetInt16 packet( 0x42, 0x00, 0x2D3D05F6, opaque( 1234 ), 0x01 );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeSetInt16 );
+
+static void BM_EncodeSetInt32( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketSetInt32 packet( 0x42, 0x00, 0x2D3D05F6, opaque( 123456 ), 0x01 );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeSetInt32 );
+
+static void BM_EncodeSetTemperature( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketSetTemperature packet( 0x42, 0x00, 0x2D3D058E, opaque( 21.5f ), 0x01 );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeSetTemperature );
+
+static void BM_EncodeInfTemperature( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketInfTemperature packet( 0x42, 0x0500021F, opaque( 4.25f ) );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeInfTemperature );
+
+static void BM_EncodeInfRoomTemperature( benchmark::State& state ) {
+  for( auto _ : state ) {
+    BsbPacketInfRoomTemperature packet( 0x42, 0x2D3D0215, opaque( 20.75f ), 0x06 );
+    benchmark::DoNotOptimize( packet );
+  }
+}
+BENCHMARK( BM_EncodeInfRoomTemperature );
+
+static void BM_CallbackPacketSubscribed( benchmark::State& state ) {
+  Fixture   fixture( state.range( 0 ) );
+  BsbPacket packet = make_packet( BsbPacket::Command::Ret, 0x053D0000 + state.range( 0 ) / 2, { 0x00, 0x0C, 0x80 } );
+
+  for( auto _ : state ) {
+    fixture.component.callback_packet( &packet, 0 );
+  }
+}
+BENCHMARK( BM_CallbackPacketSubscribed )->Arg( 10 )->Arg( 150 );
+
+static void BM_CallbackPacketUnsubscribed( benchmark::State& state ) {
+  Fixture   fixture( state.range( 0 ) );
+  BsbPacket packet = make_packet( BsbPacket::Command::Inf, 0x11110000, { 0x00, 0x0C, 0x80 } );
+
+  for( auto _ : state ) {
+    fixture.component.callback_packet( &packet, 0 );
+  }
+}
+BENCHMARK( BM_CallbackPacketUnsubscribed )->Arg( 10 )->Arg( 150 );
+
+// field ID lookup alone, half of the packets for subscribed fields
+static void BM_DispatchLookup( benchmark::State& state ) {
+  Fixture  fixture( state.range( 0 ) );
+  uint32_t i = 0;
+
+  for( auto _ : state ) {
+    const uint32_t field_id = ( i & 1 ) ? 0x11110000 + i : 0x053D0000 + ( i / 2 ) % state.range( 0 );
+    benchmark::DoNotOptimize( fixture.component.find_entities( field_id ) );
+    ++i;
+  }
+}
+BENCHMARK( BM_DispatchLookup )->Arg( 10 )->Arg( 150 );
+
+// the same lookups on one unordered_multimap per entity kind, as the component did before the dispatch table
+static void BM_DispatchLookupMultimaps( benchmark::State& state ) {
+  std::unordered_multimap< uint32_t, void* > maps[3];
+  for( int64_t i = 0; i < state.range( 0 ); i++ ) {
+    maps[0].insert( { 0x053D0000 + i, nullptr } );
+    maps[1].insert( { 0x2D3D0000 + i, nullptr } );
+    maps[2].insert( { 0x2E3E0000 + i, nullptr } );
+  }
+  uint32_t i = 0;
+
+  for( auto _ : state ) {
+    const uint32_t field_id = ( i & 1 ) ? 0x11110000 + i : 0x053D0000 + ( i / 2 ) % state.range( 0 );
+    for( auto& map : maps ) {
+      benchmark::DoNotOptimize( map.equal_range( field_id ) );
+    }
+    ++i;
+  }
+}
+BENCHMARK( BM_DispatchLookupMultimaps )->Arg( 10 )->Arg( 150 );
+
+// an option table set up and looked up in both directions, like a select decoding a value and being controlled
+static void BM_OptionTable( benchmark::State& state ) {
+  const OptionTables tables( state.range( 0 ) );
+  uint32_t           i = 0;
+
+  for( auto _ : state ) {
+    BsbOptionTable table;
+    table.set( tables.options.data(), tables.by_option.data(), tables.options.size() );
+
+    int8_t value;
+    benchmark::DoNotOptimize( table.find_option( i % state.range( 0 ) ) );
+    benchmark::DoNotOptimize( table.find_value( tables.texts[( i * 7 ) % state.range( 0 )].c_str(), value ) );
+    ++i;
+  }
+}
+BENCHMARK( BM_OptionTable )->Arg( 4 )->Arg( 32 );
+
+// the same with the two maps BsbSelect filled at setup before the option tables
+static void BM_OptionMaps( benchmark::State& state ) {
+  const OptionTables tables( state.range( 0 ) );
+  uint32_t           i = 0;
+
+  for( auto _ : state ) {
+    std::map< int8_t, std::string > value_to_option;
+    std::map< std::string, int8_t > option_to_value;
+    for( const auto& option : tables.options ) {
+      value_to_option[option.value]  = option.option;
+      option_to_value[option.option] = option.value;
+    }
+
+    benchmark::DoNotOptimize( value_to_option.find( i % state.range( 0 ) ) );
+    benchmark::DoNotOptimize( option_to_value.find( tables.texts[( i * 7 ) % state.range( 0 )] ) );
+    ++i;
+  }
+}
+BENCHMARK( BM_OptionMaps )->Arg( 4 )->Arg( 32 );
+
+BENCHMARK_MAIN();
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "esphome/components/uart/uart.h"
+
+namespace esphome {
+  namespace host {
+    // UART backed by memory: bytes queued with push_rx() are read by the device, everything it writes ends up in tx
+    class MemoryUARTComponent : public uart::UARTComponent {
+    public:
+      void push_rx( const uint8_t* data, size_t len ) { rx_.insert( rx_.end(), data, data + len ); }
+      void push_rx( const std::vector< uint8_t >& data ) { push_rx( data.data(), data.size() ); }
+
+      // makes all bytes queued so far available again, so the same stream can be replayed without copying
+      void rewind_rx() { rx_pos_ = 0; }
+      void clear_rx() {
+        rx_.clear();
+        rx_pos_ = 0;
+      }
+
+      void write_array( const uint8_t* data, size_t len ) override { tx.insert( tx.end(), data, data + len ); }
+
+      bool peek_byte( uint8_t* data ) override {
+        if( rx_pos_ >= rx_.size() ) {
+          return false;
+        }
+        *data = rx_[rx_pos_];
+        return true;
+      }
+
+      bool read_array( uint8_t* data, size_t len ) override {
+        if( rx_pos_ + len > rx_.size() ) {
+          return false;
+        }
+        std::memcpy( data, rx_.data() + rx_pos_, len );
+        rx_pos_ += len;
+        return true;
+      }
+
+      int  available() override { return rx_.size() - rx_pos_; }
+      void flush() override {}
+
+      std::vector< uint8_t > tx;
+
+    private:
+      std::vector< uint8_t > rx_;
+      size_t                 rx_pos_ = 0;
+    };
+
+    // UART on a file descriptor, e.g. the slave side of a pty. The descriptor has to be non-blocking.
+    //
+    // By default the descriptor is read when the device asks for bytes, so nothing is lost however long it waits. With
+    // start_driver(), a thread reads it all the time into a buffer of limited size, like the interrupt handler of a real
+    // UART driver into its ring buffer; bytes that do not fit are lost and counted as overruns.
+    class FdUARTComponent : public uart::UARTComponent {
+    public:
+      explicit FdUARTComponent( int fd ) : fd_( fd ) {}
+      ~FdUARTComponent() override { stop_driver(); }
+
+      void start_driver( const size_t rx_buffer_size ) {
+        rx_buffer_size_ = rx_buffer_size;
+        running_        = true;
+        driver_         = std::thread( [this]() {
+          while( running_ ) {
+            {
+              std::lock_guard< std::mutex > lock( mutex_ );
+              read_fd();
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+          }
+        } );
+      }
+
+      void stop_driver() {
+        running_ = false;
+        if( driver_.joinable() ) {
+          driver_.join();
+        }
+      }
+
+      // bytes lost because the buffer was full
+      uint32_t get_overruns() const { return overruns_; }
+
+      void write_array( const uint8_t* data, size_t len ) override {
+        while( len ) {
+          ssize_t written = ::write( fd_, data, len );
+          if( written <= 0 ) {
+            // the other side is slower than us, like a full TX FIFO
+            usleep( 100 );
+            continue;
+          }
+          data += written;
+          len -= written;
+        }
+      }
+
+      bool peek_byte( uint8_t* data ) override {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        fill();
+        if( rx_.empty() ) {
+          return false;
+        }
+        *data = rx_.front();
+        return true;
+      }
+
+      bool read_array( uint8_t* data, size_t len ) override {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        fill();
+        if( rx_.size() < len ) {
+          return false;
+        }
+        std::memcpy( data, rx_.data(), len );
+        rx_.erase( rx_.begin(), rx_.begin() + len );
+        return true;
+      }
+
+      int available() override {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        fill();
+        return rx_.size();
+      }
+
+      void flush() override {}
+
+    private:
+      void fill() {
+        if( !running_ ) {
+          read_fd();
+        }
+      }
+
+      void read_fd() {
+        uint8_t block[256];
+        ssize_t len;
+        while( ( len = ::read( fd_, block, sizeof( block ) ) ) > 0 ) {
+          size_t keep = len;
+          if( rx_buffer_size_ != 0 && rx_.size() + keep > rx_buffer_size_ ) {
+            keep = rx_buffer_size_ - std::min( rx_buffer_size_, rx_.size() );
+            overruns_ += len - keep;
+          }
+          rx_.insert( rx_.end(), block, block + keep );
+        }
+      }
+
+      int                    fd_;
+      std::vector< uint8_t > rx_;
+
+      std::mutex              mutex_;
+      std::thread             driver_;
+      std::atomic< bool >     running_ { false };
+      size_t                  rx_buffer_size_ = 0;
+      std::atomic< uint32_t > overruns_ { 0 };
+    };
+  }
+}
@@ -0,0 +1,352 @@
+// Decodes a recorded bus offline with the receive state machine of the component and prints statistics per field:
+// frames per command, the range of the values, the time between answers/broadcasts and the receive errors.
+//
+//   bsb_replay [options] FILE
+//     FILE                   a pcap file (as written by bsb_simulator --capture or served at /bsb/capture.pcap) or a raw
+//                            byte stream as read from the UART, '-' for stdin
+//     --not-inverted         the raw byte stream is already flipped (default: as read from the UART, inverted)
+//     --field ID             only print the statistics and frames of this field
+//     --frames               print every decoded frame
+//
+// The frames the component sent are in a pcap file twice on a real bus: as sent, and as their echo received. Only the
+// received frames go into the statistics, the sent ones are counted in a column of their own.
+// The input is streamed in blocks, the memory used only depends on the number of different fields on the bus. Raw byte
+// streams carry no timestamps, the time of a frame is its offset in the stream at 4800 baud.
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bsbPacketReceive.h"
+#include "bsbTrace.h"
+
+using namespace esphome::bsb;
+
+namespace {
+  constexpr uint32_t ByteTimeUs = 11 * 1000000 / 4800;
+  constexpr size_t   BlockSize  = 64 * 1024;
+
+  struct Options {
+    std::string file;
+    uint32_t    field_id     = 0;
+    bool        filter       = false;
+    bool        not_inverted = false;
+    bool        frames       = false;
+  };
+
+  bool parse_options( int argc, char** argv, Options& options ) {
+    for( int i = 1; i < argc; i++ ) {
+      std::string arg = argv[i];
+
+      if( arg == "--field" && i + 1 < argc ) {
+        options.field_id = std::strtoul( argv[++i], nullptr, 16 );
+        options.filter   = true;
+      } else if( arg == "--not-inverted" ) {
+        options.not_inverted = true;
+      } else if( arg == "--frames" ) {
+        options.frames = true;
+      } else if( options.file.empty() && ( arg == "-" || arg[0] != '-' ) ) {
+        options.file = arg;
+      } else {
+        std::fprintf( stderr, "unknown or incomplete option: %s\n", arg.c_str() );
+        return false;
+      }
+    }
+
+    if( options.file.empty() ) {
+      std::fprintf( stderr, "usage: bsb_replay [--not-inverted] [--field ID] [--frames] FILE\n" );
+      return false;
+    }
+    return true;
+  }
+
+  // everything seen of one field; values are the raw integers as parse_as_int8/int16/int32 give them
+  struct FieldStats {
+    uint32_t           commands[8]   = {};
+    uint32_t           sent          = 0;
+    std::bitset< 128 > sources;
+    uint8_t            payload_size  = 0;
+    bool               sized         = false;
+    bool               mixed_sizes   = false;
+    uint32_t           values        = 0;
+    int64_t            min_value     = std::numeric_limits< int64_t >::max();
+    int64_t            max_value     = std::numeric_limits< int64_t >::min();
+    uint64_t           last_value_us = 0;
+    uint32_t           intervals     = 0;
+    uint64_t           min_interval  = std::numeric_limits< uint64_t >::max();
+    uint64_t           max_interval  = 0;
+    uint64_t           sum_intervals = 0;
+
+    uint32_t frames() const {
+      uint32_t sum = 0;
+      for( const auto count : commands ) {
+        sum += count;
+      }
+      return sum;
+    }
+  };
+
+  class Replay {
+  public:
+    explicit Replay( const Options& options )
+        : options_( options )
+        , receive_( [this]( const BsbPacket* packet ) { on_packet( packet, BsbTraceRecord::CrcOk ); } )
+        , sent_( [this]( const BsbPacket* packet ) { on_sent( packet ); } ) {
+      receive_.set_crc_error_callback( [this]( const BsbPacket* packet ) { on_packet( packet, 0 ); } );
+    }
+
+    // a raw byte stream, the time advances with each byte
+    void feed_raw( uint8_t* data, const size_t len ) {
+      if( !options_.not_inverted ) {
+        invert_bytes( data, len );
+      }
+      for( size_t i = 0; i < len; i++ ) {
+        now_us_ += ByteTimeUs;
+        receive_.loop( data[i] );
+      }
+      bytes_ += len;
+    }
+
+    // one frame out of a pcap record, as recorded by the trace of the component
+    void feed_frame( const uint64_t timestamp_us, const BsbTraceDirection direction, const uint8_t* data, const size_t len ) {
+      framed_ = true;
+      now_us_ = timestamp_us;
+      if( direction == BsbTraceDirection::Transmit ) {
+        sent_.loop( data, len );
+        return;
+      }
+      receive_.loop( data, len );
+      bytes_ += len;
+    }
+
+    void print() const {
+      std::printf( "field     src      frames    Get    Ret    Inf    Set    Ack   Nack   sent  len         min         max   "
+                   "interval s min/avg/max\n" );
+
+      for( const auto& entry : fields_ ) {
+        if( options_.filter && entry.first != options_.field_id ) {
+          continue;
+        }
+        const FieldStats& stats = entry.second;
+
+        std::string sources;
+        for( uint8_t i = 0; i < stats.sources.size(); i++ ) {
+          if( stats.sources[i] ) {
+            char str[4];
+            std::snprintf( str, sizeof( str ), sources.empty() ? "%02X" : ",%02X", i );
+            sources += str;
+          }
+        }
+
+        std::printf( "%08X  %-6s %8u %6u %6u %6u %6u %6u %6u %6u",
+                     entry.first,
+                     sources.c_str(),
+                     stats.frames(),
+                     stats.commands[( uint8_t )BsbPacket::Command::Get],
+                     stats.commands[( uint8_t )BsbPacket::Command::Ret],
+                     stats.commands[( uint8_t )BsbPacket::Command::Inf],
+                     stats.commands[( uint8_t )BsbPacket::Command::Set],
+                     stats.commands[( uint8_t )BsbPacket::Command::Ack],
+                     stats.commands[( uint8_t )BsbPacket::Command::Nack],
+                     stats.sent );
+
+        if( stats.mixed_sizes ) {
+          std::printf( "    *" );
+        } else {
+          std::printf( " %4u", stats.payload_size );
+        }
+
+        if( stats.values ) {
+          std::printf( " %11" PRId64 " %11" PRId64, stats.min_value, stats.max_value );
+        } else {
+          std::printf( " %11s %11s", "-", "-" );
+        }
+
+        if( stats.intervals ) {
+          std::printf( "   %.1f/%.1f/%.1f",
+                       stats.min_interval / 1e6,
+                       stats.sum_intervals / 1e6 / stats.intervals,
+                       stats.max_interval / 1e6 );
+        }
+        std::printf( "\n" );
+      }
+
+      // the frames of a pcap file are complete, the receiver never has to search for their start
+      std::printf( "\n%" PRIu64 " bytes, %" PRIu64 " frames, %u CRC errors", bytes_, frames_, receive_.get_crc_errors() );
+      if( framed_ ) {
+        std::printf( ", %" PRIu64 " frames sent\n", sent_frames_ );
+      } else {
+        std::printf( ", %u resyncs, %u bytes outside of frames\n", receive_.get_resyncs(), receive_.get_skipped_bytes() );
+      }
+    }
+
+    uint64_t get_bytes() const { return bytes_; }
+
+  private:
+    void print_frame( const BsbPacket* packet, const BsbTraceDirection direction, const uint8_t flags ) const {
+      if( !options_.frames || ( options_.filter && packet->fieldId != options_.field_id ) ) {
+        return;
+      }
+      BsbTraceRecord record;
+      record.timestamp_us = now_us_;
+      record.direction    = direction;
+      record.flags        = flags;
+      record.size         = packet->buffer.size();
+      std::memcpy( record.data, packet->buffer.data(), record.size );
+
+      char line[160];
+      format_trace_record( record, line, sizeof( line ) );
+      std::printf( "%s\n", line );
+    }
+
+    void on_sent( const BsbPacket* packet ) {
+      ++sent_frames_;
+      print_frame( packet, BsbTraceDirection::Transmit, BsbTraceRecord::CrcOk );
+      ++fields_[packet->fieldId].sent;
+    }
+
+    void on_packet( const BsbPacket* packet, const uint8_t flags ) {
+      ++frames_;
+      print_frame( packet, BsbTraceDirection::Receive, flags );
+
+      // the header of a frame with a wrong CRC can't be trusted, it is only counted by the receiver
+      if( !( flags & BsbTraceRecord::CrcOk ) ) {
+        return;
+      }
+
+      FieldStats& stats = fields_[packet->fieldId];
+      ++stats.commands[( uint8_t )packet->command & 0x07];
+      stats.sources.set( packet->sourceAddress & 0x7F );
+
+      if( packet->command != BsbPacket::Command::Ret && packet->command != BsbPacket::Command::Inf &&
+          packet->command != BsbPacket::Command::Set ) {
+        return;
+      }
+
+      if( !stats.sized ) {
+        stats.payload_size = packet->payloadSize;
+        stats.sized        = true;
+      } else if( stats.payload_size != packet->payloadSize ) {
+        stats.mixed_sizes = true;
+      }
+
+      int64_t value;
+      switch( packet->payloadSize ) {
+        case 2:
+          value = packet->parse_as_uint8();
+          break;
+        case 3:
+          value = packet->parse_as_int16();
+          break;
+        case 5:
+          value = packet->parse_as_int32();
+          break;
+        default:
+          value = 0;
+          break;
+      }
+      if( packet->payloadSize == 2 || packet->payloadSize == 3 || packet->payloadSize == 5 ) {
+        ++stats.values;
+        stats.min_value = std::min( stats.min_value, value );
+        stats.max_value = std::max( stats.max_value, value );
+      }
+
+      // a Set is a write, not a refresh of the value
+      if( packet->command == BsbPacket::Command::Set ) {
+        return;
+      }
+      if( stats.last_value_us != 0 && now_us_ > stats.last_value_us ) {
+        const uint64_t interval = now_us_ - stats.last_value_us;
+        ++stats.intervals;
+        stats.min_interval = std::min( stats.min_interval, interval );
+        stats.max_interval = std::max( stats.max_interval, interval );
+        stats.sum_intervals += interval;
+      }
+      stats.last_value_us = now_us_;
+    }
+
+    const Options&                   options_;
+    BsbPacketReceive                 receive_;
+    BsbPacketReceive                 sent_;
+    std::map< uint32_t, FieldStats > fields_;
+    uint64_t                         now_us_      = 0;
+    uint64_t                         bytes_       = 0;
+    uint64_t                         frames_      = 0;
+    uint64_t                         sent_frames_ = 0;
+    bool                             framed_      = false;
+  };
+
+  uint32_t get32( const uint8_t* data ) { return data[0] | data[1] << 8 | data[2] << 16 | ( uint32_t )data[3] << 24; }
+
+  // streams the records of a pcap file (link type USER0 as written by export_pcap) into the replay
+  bool replay_pcap( FILE* in, const uint8_t* header, Replay& replay ) {
+    if( get32( header + 20 ) != pcap::LinkTypeUser0 ) {
+      std::fprintf( stderr, "not a BSB capture (link type %u)\n", get32( header + 20 ) );
+      return false;
+    }
+
+    uint8_t record[16];
+    uint8_t data[256];
+    while( std::fread( record, 1, sizeof( record ), in ) == sizeof( record ) ) {
+      const uint64_t timestamp_us = ( uint64_t )get32( record ) * 1000000 + get32( record + 4 );
+      const uint32_t size         = get32( record + 8 );
+
+      if( size > sizeof( data ) || std::fread( data, 1, size, in ) != size ) {
+        std::fprintf( stderr, "truncated or corrupt pcap record\n" );
+        return false;
+      }
+      // direction and flags, then the frame
+      if( size > 2 ) {
+        replay.feed_frame( timestamp_us, ( BsbTraceDirection )data[0], data + 2, size - 2 );
+      }
+    }
+    return true;
+  }
+}
+
+int main( int argc, char** argv ) {
+  Options options;
+  if( !parse_options( argc, argv, options ) ) {
+    return 1;
+  }
+
+  FILE* in = options.file == "-" ? stdin : std::fopen( options.file.c_str(), "rb" );
+  if( in == nullptr ) {
+    std::perror( options.file.c_str() );
+    return 1;
+  }
+
+  Replay     replay( options );
+  const auto start = std::chrono::steady_clock::now();
+  bool       ok    = true;
+
+  std::vector< uint8_t > block( BlockSize );
+  size_t                 len = std::fread( block.data(), 1, pcap::HeaderSize, in );
+  if( len == pcap::HeaderSize && get32( block.data() ) == pcap::Magic ) {
+    ok = replay_pcap( in, block.data(), replay );
+  } else {
+    while( len > 0 ) {
+      replay.feed_raw( block.data(), len );
+      len = std::fread( block.data(), 1, block.size(), in );
+    }
+  }
+
+  if( in != stdin ) {
+    std::fclose( in );
+  }
+
+  replay.print();
+
+  const double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+  std::fprintf( stderr, "decoded in %.2f s (%.1f MB/s)\n", seconds, replay.get_bytes() / 1e6 / std::max( seconds, 1e-9 ) );
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,708 @@
+// Runs the host build of BsbComponent against a simulated heating controller on a pty and reports how well the
+// polling keeps up: Get->Ret round trip latency, polls per second and the freshness of each entity.
+//
+//   bsb_simulator [options]
+//     --fields FILE          field table of the controller (see heater_simulator.h), default: a small built-in table
+//     --delay MS             controller response delay (default 50)
+//     --jitter MS            additional random response delay (default 0)
+//     --duration S           simulated time (default 60)
+//     --query-interval MS    BsbComponent query_interval (default 50)
+//     --request-timeout MS   BsbComponent request_timeout (default 500)
+//     --bus-idle N           BsbComponent bus_idle_bytes (default 3)
+//     --bus-backoff N        BsbComponent bus_backoff_bytes (default 4)
+//     --update-interval MS   update_interval of all entities (default 10000)
+//     --min-update-interval MS, --max-update-interval MS
+//                            adaptive polling of all entities between these intervals (default 0: fixed)
+//     --retry-interval MS    BsbComponent retry_interval (default 15000)
+//     --retry-count N        BsbComponent retry_count (default 3)
+//     --loop-interval MS     time between two calls of loop(), like the ESPHome main loop (default 16)
+//     --set-interval MS      change a writable field or time program every MS (default 0: never)
+//     --scene                change all writable fields at once every set interval, like a scene or a script
+//     --shared N             add N more sensors on each field (default 0)
+//     --passive              BsbComponent passive_refresh
+//     --heartbeat MS         only publish changed values, and unchanged ones every MS (default 0: publish all)
+//     --receive-task         BsbComponent receive_task: receive in a thread of its own instead of in loop()
+//     --stall MS             block the main loop for MS every stall interval, like a Wi-Fi reconnect (default 0: never)
+//     --stall-interval MS    time between two stalls (default 10000)
+//     --rx-buffer N          receive into a UART buffer of N bytes in the background, bytes that do not fit are lost
+//                            (default 0: unlimited, read when asked for)
+//     --cache FILE           BsbComponent value cache, kept in FILE across runs
+//     --cache-interval MS    BsbComponent value_cache_interval (default 60000)
+//     --optimistic           writable entities take the Ack as confirmation instead of reading the value back
+//     --refuse N             the controller refuses every N-th Set with Nack (default 0: none)
+//     --trace                print the packet trace of the component at the end
+//     --capture FILE         write the packet trace of the component as pcap file at the end
+//     --controller-only      only run the controller and print the pty to connect to, until interrupted
+//     --verbose              print the component log
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "bsb.h"
+#include "heater_simulator.h"
+#include "host_uart.h"
+
+using namespace esphome;
+using namespace esphome::bsb;
+using namespace esphome::host;
+
+namespace {
+  std::atomic< bool > stop { false };
+
+  struct Options {
+    std::string fields_file;
+    std::string capture_file;
+    std::string cache_file;
+    uint32_t    delay_ms           = 50;
+    uint32_t    jitter_ms          = 0;
+    uint32_t    duration_s         = 60;
+    uint32_t    query_interval_ms  = 50;
+    uint32_t    request_timeout_ms = 500;
+    uint32_t    bus_idle_bytes     = 3;
+    uint32_t    bus_backoff_bytes  = 4;
+    uint32_t    update_interval_ms = 10000;
+    uint32_t    min_update_ms      = 0;
+    uint32_t    max_update_ms      = 0;
+    uint32_t    retry_interval_ms  = 15000;
+    uint32_t    retry_count        = 3;
+    uint32_t    loop_interval_ms   = 16;
+    uint32_t    set_interval_ms    = 0;
+    uint32_t    shared             = 0;
+    uint32_t    heartbeat_ms       = 0;
+    uint32_t    refuse_every       = 0;
+    uint32_t    stall_ms           = 0;
+    uint32_t    stall_interval_ms  = 10000;
+    uint32_t    rx_buffer          = 0;
+    uint32_t    cache_interval_ms  = 60000;
+    bool        receive_task       = false;
+    bool        scene              = false;
+    bool        optimistic         = false;
+    bool        passive            = false;
+    bool        trace              = false;
+    bool        controller_only    = false;
+    bool        verbose            = false;
+  };
+
+  bool parse_options( int argc, char** argv, Options& options ) {
+    for( int i = 1; i < argc; i++ ) {
+      std::string arg = argv[i];
+
+      auto value = [&]( uint32_t& target ) {
+        if( i + 1 >= argc ) {
+          return false;
+        }
+        target = std::strtoul( argv[++i], nullptr, 0 );
+        return true;
+      };
+
+      bool ok = true;
+      if( arg == "--fields" && i + 1 < argc ) {
+        options.fields_file = argv[++i];
+      } else if( arg == "--cache" && i + 1 < argc ) {
+        options.cache_file = argv[++i];
+      } else if( arg == "--cache-interval" ) {
+        ok = value( options.cache_interval_ms );
+      } else if( arg == "--capture" && i + 1 < argc ) {
+        options.capture_file = argv[++i];
+      } else if( arg == "--delay" ) {
+        ok = value( options.delay_ms );
+      } else if( arg == "--jitter" ) {
+        ok = value( options.jitter_ms );
+      } else if( arg == "--duration" ) {
+        ok = value( options.duration_s );
+      } else if( arg == "--query-interval" ) {
+        ok = value( options.query_interval_ms );
+      } else if( arg == "--request-timeout" ) {
+        ok = value( options.request_timeout_ms );
+      } else if( arg == "--bus-idle" ) {
+        ok = value( options.bus_idle_bytes );
+      } else if( arg == "--bus-backoff" ) {
+        ok = value( options.bus_backoff_bytes );
+      } else if( arg == "--update-interval" ) {
+        ok = value( options.update_interval_ms );
+      } else if( arg == "--min-update-interval" ) {
+        ok = value( options.min_update_ms );
+      } else if( arg == "--max-update-interval" ) {
+        ok = value( options.max_update_ms );
+      } else if( arg == "--retry-interval" ) {
+        ok = value( options.retry_interval_ms );
+      } else if( arg == "--retry-count" ) {
+        ok = value( options.retry_count );
+      } else if( arg == "--loop-interval" ) {
+        ok = value( options.loop_interval_ms );
+      } else if( arg == "--set-interval" ) {
+        ok = value( options.set_interval_ms );
+      } else if( arg == "--shared" ) {
+        ok = value( options.shared );
+      } else if( arg == "--heartbeat" ) {
+        ok = value( options.heartbeat_ms );
+      } else if( arg == "--refuse" ) {
+        ok = value( options.refuse_every );
+      } else if( arg == "--stall" ) {
+        ok = value( options.stall_ms );
+      } else if( arg == "--stall-interval" ) {
+        ok = value( options.stall_interval_ms );
+      } else if( arg == "--rx-buffer" ) {
+        ok = value( options.rx_buffer );
+      } else if( arg == "--receive-task" ) {
+        options.receive_task = true;
+      } else if( arg == "--scene" ) {
+        options.scene = true;
+      } else if( arg == "--optimistic" ) {
+        options.optimistic = true;
+      } else if( arg == "--passive" ) {
+        options.passive = true;
+      } else if( arg == "--trace" ) {
+        options.trace = true;
+      } else if( arg == "--controller-only" ) {
+        options.controller_only = true;
+      } else if( arg == "--verbose" ) {
+        options.verbose = true;
+      } else {
+        ok = false;
+      }
+
+      if( !ok ) {
+        std::fprintf( stderr, "unknown or incomplete option: %s\n", arg.c_str() );
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // the component side of the pty, in raw mode so all bytes pass unchanged
+  int open_pty( int& master, std::string& slave_name ) {
+    master = posix_openpt( O_RDWR | O_NOCTTY | O_NONBLOCK );
+    if( master < 0 || grantpt( master ) != 0 || unlockpt( master ) != 0 ) {
+      return -1;
+    }
+    slave_name = ptsname( master );
+
+    int slave = open( slave_name.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+    if( slave < 0 ) {
+      return -1;
+    }
+
+    termios tio;
+    tcgetattr( slave, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( slave, TCSANOW, &tio );
+
+    return slave;
+  }
+
+  // watches both directions of the UART to time requests against their answers; with the receive task, the directions
+  // are tapped by different threads
+  class TapUARTComponent : public FdUARTComponent {
+  public:
+    explicit TapUARTComponent( int fd )
+        : FdUARTComponent( fd )
+        , tx_( [this]( const BsbPacket* packet ) { on_tx( packet ); } )
+        , rx_( [this]( const BsbPacket* packet ) { on_rx( packet ); } ) {}
+
+    void write_array( const uint8_t* data, size_t len ) override {
+      tap( tx_, data, len );
+      FdUARTComponent::write_array( data, len );
+    }
+
+    bool read_array( uint8_t* data, size_t len ) override {
+      if( !FdUARTComponent::read_array( data, len ) ) {
+        return false;
+      }
+      tap( rx_, data, len );
+      return true;
+    }
+
+    uint32_t gets = 0;
+    uint32_t sets = 0;
+    uint32_t rets = 0;
+    uint32_t acks = 0;
+    uint32_t nacks = 0;
+
+    std::vector< uint32_t > get_latencies_us;
+    std::vector< uint32_t > set_latencies_us;
+
+  private:
+    static void tap( BsbPacketReceive& receive, const uint8_t* data, size_t len ) {
+      std::vector< uint8_t > block( data, data + len );
+      invert_bytes( block.data(), block.size() );
+      receive.loop( block.data(), block.size() );
+    }
+
+    void on_tx( const BsbPacket* packet ) {
+      std::lock_guard< std::mutex > lock( mutex_ );
+      const uint32_t                fieldId = packet->fieldId;
+      if( packet->command == BsbPacket::Command::Get ) {
+        ++gets;
+        outstanding_get_[fieldId] = now_us();
+      } else if( packet->command == BsbPacket::Command::Set ) {
+        ++sets;
+        outstanding_set_[fieldId] = now_us();
+      }
+    }
+
+    void on_rx( const BsbPacket* packet ) {
+      std::lock_guard< std::mutex > lock( mutex_ );
+      switch( packet->command ) {
+        case BsbPacket::Command::Ret:
+          ++rets;
+          complete( outstanding_get_, packet->fieldId, get_latencies_us );
+          break;
+        case BsbPacket::Command::Ack:
+          ++acks;
+          complete( outstanding_set_, packet->fieldId, set_latencies_us );
+          break;
+        case BsbPacket::Command::Nack:
+          ++nacks;
+          complete( outstanding_set_, packet->fieldId, set_latencies_us );
+          break;
+        default:
+          break;
+      }
+    }
+
+    static void complete( std::map< uint32_t, uint64_t >& outstanding, const uint32_t fieldId, std::vector< uint32_t >& latencies ) {
+      auto it = outstanding.find( fieldId );
+      if( it != outstanding.end() ) {
+        latencies.push_back( now_us() - it->second );
+        outstanding.erase( it );
+      }
+    }
+
+    std::mutex                       mutex_;
+    BsbPacketReceive                 tx_;
+    BsbPacketReceive                 rx_;
+    std::map< uint32_t, uint64_t > outstanding_get_;
+    std::map< uint32_t, uint64_t > outstanding_set_;
+  };
+
+  // how current the value of one entity is kept
+  struct Freshness {
+    uint32_t    fieldId;
+    const char* kind;
+    uint32_t    updates   = 0;
+    uint64_t    first     = 0;
+    uint64_t    last      = 0;
+    uint64_t    max_gap   = 0;
+
+    // a value set through the entity, waiting to be published as confirmed
+    uint64_t set_at = 0;
+    float    target = 0;
+
+    void update() {
+      const uint64_t now = now_us();
+      if( updates == 0 ) {
+        first = now;
+      } else {
+        max_gap = std::max( max_gap, now - last );
+      }
+      last = now;
+      ++updates;
+    }
+  };
+
+  // the time from setting a value until it is published as confirmed, and the values reverted instead
+  std::vector< uint32_t > confirm_latencies_us;
+  uint32_t                reverts = 0;
+
+  // the time from a scene until its last value is confirmed or reverted
+  std::vector< uint32_t > scene_latencies_us;
+  uint64_t                scene_at      = 0;
+  uint32_t                scene_pending = 0;
+
+  void published( Freshness* f, const float value ) {
+    if( f->set_at == 0 ) {
+      return;
+    }
+    if( value == f->target ) {
+      confirm_latencies_us.push_back( now_us() - f->set_at );
+    } else {
+      ++reverts;
+    }
+    f->set_at = 0;
+
+    if( scene_pending != 0 && --scene_pending == 0 ) {
+      scene_latencies_us.push_back( now_us() - scene_at );
+    }
+  }
+
+  void print_latencies( const char* name, std::vector< uint32_t > latencies ) {
+    if( latencies.empty() ) {
+      std::printf( "%s: no samples\n", name );
+      return;
+    }
+
+    std::sort( latencies.begin(), latencies.end() );
+    auto percentile = [&]( double p ) { return latencies[std::min( latencies.size() - 1, ( size_t )( p * latencies.size() ) )] / 1000.; };
+    std::printf( "%s: n=%zu p50=%.1fms p90=%.1fms p99=%.1fms max=%.1fms\n",
+                 name,
+                 latencies.size(),
+                 percentile( 0.5 ),
+                 percentile( 0.9 ),
+                 percentile( 0.99 ),
+                 latencies.back() / 1000. );
+  }
+}
+
+int main( int argc, char** argv ) {
+  Options options;
+  if( !parse_options( argc, argv, options ) ) {
+    return 1;
+  }
+
+  std::vector< SimulatedField > fields;
+  if( options.fields_file.empty() ) {
+    fields = HeaterSimulator::default_fields();
+  } else {
+    std::string error;
+    if( !HeaterSimulator::load_fields( options.fields_file, fields, error ) ) {
+      std::fprintf( stderr, "%s\n", error.c_str() );
+      return 1;
+    }
+  }
+
+  int         master;
+  std::string slave_name;
+  int         slave = open_pty( master, slave_name );
+  if( slave < 0 ) {
+    std::perror( "pty" );
+    return 1;
+  }
+
+  HeaterSimulator controller( master, fields );
+  controller.set_response_delay( options.delay_ms, options.jitter_ms );
+  controller.set_refuse_every( options.refuse_every );
+
+  std::signal( SIGINT, []( int ) { stop = true; } );
+  std::thread controller_thread( [&]() { controller.run( stop ); } );
+
+  if( options.controller_only ) {
+    std::printf( "simulated controller on %s (inverted, 4800 baud timing), ^C to stop\n", slave_name.c_str() );
+    controller_thread.join();
+    return 0;
+  }
+
+  host_log_level = options.verbose ? ESPHOME_LOG_LEVEL_DEBUG : ESPHOME_LOG_LEVEL_WARN;
+
+  TapUARTComponent uart( slave );
+  if( options.rx_buffer ) {
+    uart.start_driver( options.rx_buffer );
+  }
+  BsbComponent     component;
+  component.set_uart_parent( &uart );
+  component.set_query_interval( options.query_interval_ms );
+  component.set_request_timeout( options.request_timeout_ms );
+  // never publish, so the metrics histograms cover the whole run
+  component.set_metrics_interval( 0 );
+  component.set_bus_idle_bytes( options.bus_idle_bytes );
+  component.set_bus_backoff_bytes( options.bus_backoff_bytes );
+  component.set_passive_refresh( options.passive );
+  component.set_receive_task( options.receive_task );
+  if( !options.cache_file.empty() ) {
+    global_preferences->load_file( options.cache_file );
+    component.set_value_cache_interval( options.cache_interval_ms );
+  }
+  component.set_retry_interval( options.retry_interval_ms );
+  component.set_retry_count( options.retry_count );
+  component.set_source_address( 0x42 );
+  component.set_destination_address( 0x00 );
+
+  // every field of the controller gets an entity: writable ones a number, the others a sensor, and seven schedules
+  // in a row a time program
+  std::vector< std::unique_ptr< BsbSensor > >      sensors;
+  std::vector< std::unique_ptr< BsbNumber > >      numbers;
+  std::vector< Freshness* >                        number_freshness;
+  std::vector< std::unique_ptr< BsbTimeProgram > > programs;
+  std::vector< std::unique_ptr< Freshness > >      freshness;
+
+  for( size_t i = 0; i < fields.size(); i++ ) {
+    const auto& field = fields[i];
+
+    if( !field.flag ) {
+      size_t days = 1;
+      while( days < TimeProgramDays && i + days < fields.size() && !fields[i + days].flag &&
+             fields[i + days].fieldId == field.fieldId + days ) {
+        ++days;
+      }
+      if( days < TimeProgramDays ) {
+        std::fprintf( stderr, "schedule %08X is not part of seven consecutive days, ignored\n", field.fieldId );
+        continue;
+      }
+
+      auto f        = std::make_unique< Freshness >();
+      f->fieldId    = field.fieldId;
+      f->kind       = "week";
+      Freshness* fp = f.get();
+
+      auto program = std::make_unique< BsbTimeProgram >();
+      program->set_field_id( field.fieldId );
+      program->set_update_interval( options.update_interval_ms );
+      program->set_retry_interval( options.retry_interval_ms );
+      program->set_retry_count( options.retry_count );
+      program->add_on_state_callback( [fp]( std::string ) { fp->update(); } );
+      if( options.heartbeat_ms ) {
+        program->set_heartbeat( options.heartbeat_ms );
+      }
+      program->set_min_update_interval( options.min_update_ms );
+      program->set_max_update_interval( options.max_update_ms );
+      program->set_optimistic( options.optimistic );
+      component.register_time_program( program.get() );
+      programs.push_back( std::move( program ) );
+      freshness.push_back( std::move( f ) );
+
+      i += TimeProgramDays - 1;
+      continue;
+    }
+
+    const int type = field.value.size() == 2 ? ( int )BsbSensorValueType::Int8
+                   : field.value.size() == 3 ? ( int )BsbSensorValueType::Int16
+                                             : ( int )BsbSensorValueType::Int32;
+
+    auto f     = std::make_unique< Freshness >();
+    f->fieldId = field.fieldId;
+    Freshness* fp = f.get();
+
+    if( field.writable ) {
+      auto number = std::make_unique< BsbNumber >();
+      number->set_field_id( field.fieldId );
+      number->set_value_type( type );
+      number->set_update_interval( options.update_interval_ms );
+      number->set_retry_interval( options.retry_interval_ms );
+      number->set_retry_count( options.retry_count );
+      number->add_on_state_callback( [fp]( float value ) {
+        fp->update();
+        published( fp, value );
+      } );
+      number->set_optimistic( options.optimistic );
+      if( options.heartbeat_ms ) {
+        number->set_heartbeat( options.heartbeat_ms );
+      }
+      number->set_min_update_interval( options.min_update_ms );
+      number->set_max_update_interval( options.max_update_ms );
+      component.register_number( number.get() );
+      f->kind = "number";
+      numbers.push_back( std::move( number ) );
+      number_freshness.push_back( fp );
+    } else {
+      auto sensor = std::make_unique< BsbSensor >();
+      sensor->set_field_id( field.fieldId );
+      sensor->set_value_type( type );
+      sensor->set_update_interval( options.update_interval_ms );
+      sensor->set_retry_interval( options.retry_interval_ms );
+      sensor->set_retry_count( options.retry_count );
+      sensor->add_on_state_callback( [fp]( float ) { fp->update(); } );
+      if( options.heartbeat_ms ) {
+        sensor->set_heartbeat( options.heartbeat_ms );
+      }
+      sensor->set_min_update_interval( options.min_update_ms );
+      sensor->set_max_update_interval( options.max_update_ms );
+      component.register_sensor( sensor.get() );
+      f->kind = "sensor";
+      sensors.push_back( std::move( sensor ) );
+    }
+
+    // further entities on the same field, like a raw and a scaled sensor; they are updated by the same answers
+    for( uint32_t i = 0; i < options.shared; i++ ) {
+      auto sensor = std::make_unique< BsbSensor >();
+      sensor->set_field_id( field.fieldId );
+      sensor->set_value_type( type );
+      sensor->set_update_interval( options.update_interval_ms );
+      sensor->set_retry_interval( options.retry_interval_ms );
+      sensor->set_retry_count( options.retry_count );
+      component.register_sensor( sensor.get() );
+      sensors.push_back( std::move( sensor ) );
+    }
+
+    freshness.push_back( std::move( f ) );
+  }
+
+  component.setup();
+  if( options.verbose ) {
+    component.dump_config();
+  }
+
+  const uint64_t start    = now_us();
+  const uint64_t end      = start + options.duration_s * 1000000ull;
+  uint64_t       next_set = start + options.set_interval_ms * 1000ull;
+  size_t         set_index = 0;
+  uint64_t       next_stall = start + options.stall_interval_ms * 1000ull;
+
+  while( !stop && now_us() < end ) {
+    component.loop();
+
+    const size_t writable = numbers.size() + programs.size();
+    if( options.scene && options.set_interval_ms && !numbers.empty() && now_us() >= next_set ) {
+      next_set += options.set_interval_ms * 1000ull;
+      // a scene still in progress is not counted when the next one starts
+      scene_at      = now_us();
+      scene_pending = numbers.size();
+      for( size_t index = 0; index < numbers.size(); index++ ) {
+        Freshness* f = number_freshness[index];
+        f->set_at    = scene_at;
+        f->target    = numbers[index]->state + 1;
+        numbers[index]->control( f->target );
+      }
+    } else if( !options.scene && options.set_interval_ms && writable != 0 && now_us() >= next_set ) {
+      next_set += options.set_interval_ms * 1000ull;
+      const size_t index = set_index++ % writable;
+      if( index < numbers.size() ) {
+        BsbNumber* number    = numbers[index].get();
+        Freshness* f         = number_freshness[index];
+        f->set_at            = now_us();
+        f->target            = number->state + 1;
+        number->control( f->target );
+      } else if( programs[index - numbers.size()]->has_state() ) {
+        // one day of the week gets an extra phase or loses it again
+        BsbTimeProgram* program = programs[index - numbers.size()].get();
+        std::string     week    = program->state;
+        size_t          day     = week.find( ';' );
+        if( week.compare( 0, 12, "05:00-05:30 " ) == 0 ) {
+          week.erase( 0, 12 );
+        } else if( std::count( week.begin(), week.begin() + day, ' ' ) < 2 ) {
+          week.insert( 0, "05:00-05:30 " );
+        }
+        program->control( week );
+      }
+    }
+
+    if( options.stall_ms && now_us() >= next_stall ) {
+      next_stall += options.stall_interval_ms * 1000ull;
+      std::this_thread::sleep_for( std::chrono::milliseconds( options.stall_ms ) );
+    }
+
+    // like the ESPHome main loop, which skips its delay while a component requests it
+    if( HighFrequencyLoopRequester::is_high_frequency() ) {
+      std::this_thread::sleep_for( std::chrono::microseconds( 500 ) );
+    } else {
+      std::this_thread::sleep_for( std::chrono::milliseconds( options.loop_interval_ms ) );
+    }
+  }
+
+  // like a reboot: the cache is saved, and the receive task is stopped, so its counters are final
+  const uint32_t stale = component.count_stale_values();
+  component.on_safe_shutdown();
+  component.on_shutdown();
+  if( !options.cache_file.empty() && !global_preferences->save_file( options.cache_file ) ) {
+    std::fprintf( stderr, "could not write %s\n", options.cache_file.c_str() );
+  }
+
+  const double duration = ( now_us() - start ) / 1e6;
+  stop                  = true;
+  controller_thread.join();
+
+#ifdef BSB_TRACE_SIZE
+  if( options.trace ) {
+    host_log_level = std::max( host_log_level, ESPHOME_LOG_LEVEL_INFO );
+    component.dump_trace();
+  }
+
+  if( !options.capture_file.empty() ) {
+    std::vector< uint8_t > file;
+    export_pcap( component.get_trace(), file );
+
+    FILE* out = std::fopen( options.capture_file.c_str(), "wb" );
+    if( out == nullptr || std::fwrite( file.data(), 1, file.size(), out ) != file.size() ) {
+      std::fprintf( stderr, "could not write %s\n", options.capture_file.c_str() );
+    }
+    if( out != nullptr ) {
+      std::fclose( out );
+    }
+  }
+#endif
+
+  std::printf( "duration: %.1fs, loop interval %ums, query interval %ums, update interval %ums\n",
+               duration,
+               options.loop_interval_ms,
+               options.query_interval_ms,
+               options.update_interval_ms );
+  std::printf( "polls: %u Get (%.2f/s), %u Ret, %u Get unanswered by the controller\n",
+               uart.gets,
+               uart.gets / duration,
+               uart.rets,
+               controller.unanswered.load() );
+  std::printf( "sets: %u Set, %u Ack, %u Nack\n", uart.sets, uart.acks, uart.nacks );
+  std::printf( "controller: %u Inf broadcasts, %u polls avoided\n", controller.infs.load(), component.get_avoided_polls() );
+  print_latencies( "Get->Ret", uart.get_latencies_us );
+  print_latencies( "Set->Ack/Nack", uart.set_latencies_us );
+  // the time after start until every entity showed a value
+  uint64_t all_published = 0;
+  size_t   published     = 0;
+  for( const auto& f : freshness ) {
+    if( f->updates != 0 ) {
+      all_published = std::max< uint64_t >( all_published, f->first > start ? f->first - start : 0 );
+      ++published;
+    }
+  }
+  std::printf( "startup: %zu of %zu entities published after %.2fs, %u still stale at the end\n",
+               published,
+               freshness.size(),
+               all_published / 1e6,
+               stale );
+  if( !options.cache_file.empty() ) {
+    std::printf( "cache: %u values written to flash\n", global_preferences->get_writes() );
+  }
+  print_latencies( "set->confirmed", confirm_latencies_us );
+  print_latencies( "scene->confirmed", scene_latencies_us );
+  std::printf( "reverted: %u values refused or given up\n", reverts );
+
+  // what the component saw itself, the histograms cover the time since the last publish
+  const BsbMetrics& metrics = component.get_metrics();
+  std::printf( "metrics: %u/%u bytes in/out, %u/%u frames in/out, %u CRC errors, %u framing errors, %u retries, %u "
+               "exhausted, %u Nacks, %u timeouts\n",
+               metrics.bytes_in,
+               metrics.bytes_out,
+               metrics.frames_in,
+               metrics.frames_out,
+               metrics.crc_errors,
+               metrics.framing_errors,
+               metrics.retries,
+               metrics.retries_exhausted,
+               metrics.nacks,
+               metrics.timeouts );
+  std::printf( "metrics: %u frames dropped by the receive task, %u bytes lost to UART overruns\n",
+               metrics.frames_dropped,
+               uart.get_overruns() );
+  std::printf( "metrics: latency p50/p90/p99 %u/%u/%ums, scheduler lag p90 %ums max %ums, overrun %ums\n",
+               metrics.latency.percentile( 0.5f ),
+               metrics.latency.percentile( 0.9f ),
+               metrics.latency.percentile( 0.99f ),
+               metrics.scheduler_lag.percentile( 0.9f ),
+               metrics.scheduler_lag.max(),
+               metrics.scheduler_overrun );
+
+  std::printf( "\n%-10s  %-6s  %7s  %12s  %12s  %10s\n", "field", "kind", "updates", "mean gap [s]", "max gap [s]", "age [s]" );
+  const uint64_t now = now_us();
+  for( const auto& f : freshness ) {
+    if( f->updates == 0 ) {
+      std::printf( "%08X    %-6s  %7u  %12s  %12s  %10s\n", f->fieldId, f->kind, 0u, "-", "-", "never" );
+      continue;
+    }
+    const double mean_gap = f->updates > 1 ? ( f->last - f->first ) / 1e6 / ( f->updates - 1 ) : 0;
+    std::printf( "%08X    %-6s  %7u  %12.2f  %12.2f  %10.2f\n",
+                 f->fieldId,
+                 f->kind,
+                 f->updates,
+                 mean_gap,
+                 f->max_gap / 1e6,
+                 ( now - f->last ) / 1e6 );
+  }
+
+  uart.stop_driver();
+  close( slave );
+  close( master );
+  return 0;
+}
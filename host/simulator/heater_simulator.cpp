@@ -0,0 +1,265 @@
+#include "heater_simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "bsbTimeProgram.h"
+
+namespace esphome {
+  namespace host {
+    uint64_t now_us() {
+      static const auto start = std::chrono::steady_clock::now();
+      return std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    HeaterSimulator::HeaterSimulator( int fd, std::vector< SimulatedField > fields )
+        : fd_( fd ), fields_( std::move( fields ) ), receive_( [this]( const bsb::BsbPacket* packet ) { on_packet( packet ); } ) {
+      // spread the first broadcasts a bit, like a controller that has been running for a while
+      for( auto& field : fields_ ) {
+        field.nextInf = field.infInterval * 1000ull / 2;
+      }
+    }
+
+    void HeaterSimulator::run( const std::atomic< bool >& stop ) {
+      while( !stop ) {
+        pollfd pfd = { fd_, POLLIN, 0 };
+        if( poll( &pfd, 1, 1 ) > 0 && ( pfd.revents & POLLIN ) ) {
+          uint8_t block[64];
+          ssize_t len = read( fd_, block, sizeof( block ) );
+          if( len > 0 ) {
+            bsb::invert_bytes( block, len );
+            receive_.loop( block, len );
+          }
+        }
+
+        const uint64_t now = now_us();
+
+        // answers are given one after the other, in the order they are due
+        auto next = std::min_element(
+          pending_.begin(), pending_.end(), []( const Pending& a, const Pending& b ) { return a.due < b.due; } );
+        if( next != pending_.end() && next->due <= now ) {
+          bsb::BsbPacket packet = next->packet;
+          pending_.erase( next );
+          send( packet );
+          continue;
+        }
+
+        for( auto& field : fields_ ) {
+          if( field.infInterval && now >= field.nextInf ) {
+            field.nextInf = now + field.infInterval * 1000ull;
+
+            bsb::BsbPacket packet;
+            packet.sourceAddress      = address_;
+            packet.destinationAddress = 0x7F;
+            packet.command            = bsb::BsbPacket::Command::Inf;
+            packet.fieldId            = field.fieldId;
+            for( auto b : field.value ) {
+              packet.add_payload( b );
+            }
+            packet.create_packet();
+
+            ++infs;
+            send( packet );
+            break;
+          }
+        }
+      }
+    }
+
+    void HeaterSimulator::on_packet( const bsb::BsbPacket* packet ) {
+      if( packet->destinationAddress != address_ ) {
+        return;
+      }
+
+      const uint32_t fieldId = packet->fieldId;
+      SimulatedField* field  = find( fieldId );
+
+      bsb::BsbPacket answer;
+      answer.sourceAddress      = address_;
+      answer.destinationAddress = packet->sourceAddress;
+      answer.fieldId            = fieldId;
+
+      switch( packet->command ) {
+        case bsb::BsbPacket::Command::Get:
+          ++gets;
+          if( field == nullptr ) {
+            // real controllers answer with an error telegram, the component only sees a missing answer
+            ++unanswered;
+            return;
+          }
+          answer.command = bsb::BsbPacket::Command::Ret;
+          for( auto b : field->value ) {
+            answer.add_payload( b );
+          }
+          break;
+
+        case bsb::BsbPacket::Command::Set:
+          ++sets;
+          if( field != nullptr && field->writable && packet->payloadSize == field->value.size() &&
+              ( refuse_every_ == 0 || sets % refuse_every_ != 0 ) ) {
+            // the first byte is the enable byte of the Set and the flag byte of the Ret
+            const size_t skip = field->flag ? 1 : 0;
+            std::copy( packet->payload().begin() + skip, packet->payload().end(), field->value.begin() + skip );
+            answer.command = bsb::BsbPacket::Command::Ack;
+          } else {
+            ++nacks;
+            answer.command = bsb::BsbPacket::Command::Nack;
+          }
+          break;
+
+        default:
+          return;
+      }
+
+      answer.create_packet();
+
+      // the request is seen completely only after it went over the bus
+      uint64_t due = now_us() + packet->lenght * ByteTimeUs + delay_us_;
+      if( jitter_us_ ) {
+        due += rng_() % jitter_us_;
+      }
+      pending_.push_back( { due, answer } );
+    }
+
+    void HeaterSimulator::send( const bsb::BsbPacket& packet ) {
+      auto buffer = packet.buffer;
+      bsb::invert_bytes( buffer.data(), buffer.size() );
+
+      // the UART on the other side sees the telegram only once it is completely on the bus
+      std::this_thread::sleep_for( std::chrono::microseconds( buffer.size() * ByteTimeUs ) );
+
+      const uint8_t* data = buffer.data();
+      size_t         len  = buffer.size();
+      while( len ) {
+        ssize_t written = write( fd_, data, len );
+        if( written <= 0 ) {
+          std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+          continue;
+        }
+        data += written;
+        len -= written;
+      }
+    }
+
+    SimulatedField* HeaterSimulator::find( const uint32_t fieldId ) {
+      for( auto& field : fields_ ) {
+        if( field.fieldId == fieldId ) {
+          return &field;
+        }
+      }
+      return nullptr;
+    }
+
+    bool HeaterSimulator::encode_value( const std::string& type, const double value, std::vector< uint8_t >& payload ) {
+      payload.clear();
+      payload.push_back( 0x00 );
+
+      if( type == "uint8" || type == "int8" ) {
+        payload.push_back( ( uint8_t )( int )value );
+      } else if( type == "int16" || type == "temperature" ) {
+        int16_t v = type == "temperature" ? ( int16_t )( value * 64 ) : ( int16_t )value;
+        payload.push_back( v >> 8 );
+        payload.push_back( v );
+      } else if( type == "int32" ) {
+        int32_t v = value;
+        payload.push_back( v >> 24 );
+        payload.push_back( v >> 16 );
+        payload.push_back( v >> 8 );
+        payload.push_back( v );
+      } else {
+        return false;
+      }
+
+      return true;
+    }
+
+    bool HeaterSimulator::load_fields( const std::string& path, std::vector< SimulatedField >& fields, std::string& error ) {
+      std::ifstream file( path );
+      if( !file ) {
+        error = "cannot open " + path;
+        return false;
+      }
+
+      std::string line;
+      int         number = 0;
+      while( std::getline( file, line ) ) {
+        ++number;
+        line = line.substr( 0, line.find( '#' ) );
+
+        std::istringstream tokens( line );
+        std::string        id, type, value, flag;
+        if( !( tokens >> id ) ) {
+          continue;
+        }
+        if( !( tokens >> type >> value ) ) {
+          error = path + ":" + std::to_string( number ) + ": expected <field_id> <type> <value>";
+          return false;
+        }
+
+        SimulatedField field;
+        field.fieldId = std::stoul( id, nullptr, 0 );
+        if( type == "schedule" ) {
+          const char* phases = value == "-" ? "" : value.c_str();
+          field.value.resize( bsb::TimeProgramDayBytes );
+          field.flag = false;
+          if( !bsb::parse_time_program_day( phases, field.value.data() ) || *phases != '\0' ) {
+            error = path + ":" + std::to_string( number ) + ": invalid schedule " + value;
+            return false;
+          }
+        } else if( !encode_value( type, std::strtod( value.c_str(), nullptr ), field.value ) ) {
+          error = path + ":" + std::to_string( number ) + ": unknown type " + type;
+          return false;
+        }
+
+        while( tokens >> flag ) {
+          if( flag == "rw" ) {
+            field.writable = true;
+          } else {
+            field.infInterval = std::stoul( flag );
+          }
+        }
+
+        fields.push_back( field );
+      }
+
+      return true;
+    }
+
+    std::vector< SimulatedField > HeaterSimulator::default_fields() {
+      struct {
+        uint32_t    fieldId;
+        const char* type;
+        double      value;
+        uint32_t    infInterval;
+        bool        writable;
+      } table[] = {
+        { 0x053D0000, "int16", 97, 0, false },             // 6222 heating system type
+        { 0x0D3D0519, "temperature", 48.5, 0, false },     // 8310 boiler temperature
+        { 0x053D0834, "int8", 35, 0, false },              // 8326 burner modulation
+        { 0x053D3063, "int16", 1650, 0, false },           // 8327 water pressure
+        { 0x0500021F, "temperature", 4.25, 10000, false }, // outside temperature, broadcast
+        { 0x2D3D05F6, "int16", 70, 0, true },              // 720 heating curve slope
+        { 0x2D3D0574, "int8", 1, 0, true },                // 700 operating mode
+        { 0x2D3D058E, "temperature", 20, 0, true },        // 710 comfort setpoint
+      };
+
+      std::vector< SimulatedField > fields;
+      for( const auto& entry : table ) {
+        SimulatedField field;
+        field.fieldId     = entry.fieldId;
+        field.infInterval = entry.infInterval;
+        field.writable    = entry.writable;
+        encode_value( entry.type, entry.value, field.value );
+        fields.push_back( field );
+      }
+      return fields;
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bsbPacket.h"
+#include "bsbPacketReceive.h"
+
+namespace esphome {
+  namespace host {
+    // one parameter of the simulated controller
+    struct SimulatedField {
+      uint32_t               fieldId;
+      std::vector< uint8_t > value;           // payload of the Ret, flag byte first
+      bool                   flag        = true; // false for time programs, whose payload is only the phases
+      uint32_t               infInterval = 0; // ms between Inf broadcasts, 0 for none
+      bool                   writable    = false;
+
+      uint64_t nextInf = 0;
+    };
+
+    // Stand-in for the heating controller on the master side of a pty. Answers Get with Ret, Set with Ack (Nack for
+    // unknown or read-only fields) and broadcasts Inf telegrams. Bytes are inverted like on the bus and each telegram
+    // takes as long as it would at 4800 baud.
+    class HeaterSimulator {
+    public:
+      HeaterSimulator( int fd, std::vector< SimulatedField > fields );
+
+      void set_address( const uint8_t address ) { address_ = address; }
+      void set_response_delay( const uint32_t delay_ms, const uint32_t jitter_ms ) {
+        delay_us_  = delay_ms * 1000;
+        jitter_us_ = jitter_ms * 1000;
+      }
+      // every n-th Set of a writable field is refused with Nack, 0 for none
+      void set_refuse_every( const uint32_t n ) { refuse_every_ = n; }
+
+      // serves the bus until stop is set
+      void run( const std::atomic< bool >& stop );
+
+      // field table: one field per line, "<field_id> <type> <value> [<inf_interval_ms>] [rw]", # starts a comment. A
+      // schedule is one day of a time program, its value the phases like "06:00-08:00,17:00-22:00" or "-" for none.
+      static bool                          load_fields( const std::string& path, std::vector< SimulatedField >& fields, std::string& error );
+      static std::vector< SimulatedField > default_fields();
+      static bool                          encode_value( const std::string& type, const double value, std::vector< uint8_t >& payload );
+
+      static constexpr uint32_t ByteTimeUs = 11 * 1000000 / 4800; // start, 8 data, parity and stop bit
+
+      std::atomic< uint32_t > gets { 0 };
+      std::atomic< uint32_t > sets { 0 };
+      std::atomic< uint32_t > nacks { 0 };
+      std::atomic< uint32_t > infs { 0 };
+      std::atomic< uint32_t > unanswered { 0 };
+
+    private:
+      struct Pending {
+        uint64_t  due;
+        bsb::BsbPacket packet;
+      };
+
+      void on_packet( const bsb::BsbPacket* packet );
+      void send( const bsb::BsbPacket& packet );
+
+      SimulatedField* find( const uint32_t fieldId );
+
+      int                           fd_;
+      std::vector< SimulatedField > fields_;
+      std::vector< Pending >        pending_;
+      bsb::BsbPacketReceive         receive_;
+      std::mt19937                  rng_ { 4800 };
+
+      uint8_t  address_   = 0x00;
+      uint32_t delay_us_  = 50000;
+      uint32_t jitter_us_ = 0;
+      uint32_t refuse_every_ = 0;
+    };
+
+    uint64_t now_us();
+  }
+}
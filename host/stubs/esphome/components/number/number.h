@@ -0,0 +1,28 @@
+#pragma once
+
+#include "esphome/core/entity_base.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+  namespace number {
+    class Number : public EntityBase {
+    public:
+      void publish_state( float state ) {
+        this->state      = state;
+        this->has_state_ = true;
+        callback_.call( state );
+      }
+
+      bool has_state() const { return has_state_; }
+      void add_on_state_callback( std::function< void( float ) >&& callback ) { callback_.add( std::move( callback ) ); }
+
+      float state = 0.0f;
+
+    protected:
+      virtual void control( float value ) = 0;
+
+      bool                             has_state_ = false;
+      CallbackManager< void( float ) > callback_;
+    };
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esphome/core/entity_base.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+  namespace select {
+    class Select : public EntityBase {
+    public:
+      void publish_state( const std::string& state ) {
+        this->state      = state;
+        this->has_state_ = true;
+        callback_.call( state );
+      }
+
+      bool        has_state() const { return has_state_; }
+      std::string current_option() const { return state; }
+      void        add_on_state_callback( std::function< void( std::string ) >&& callback ) { callback_.add( std::move( callback ) ); }
+
+      std::string state;
+
+    protected:
+      virtual void control( const std::string& value ) = 0;
+
+      bool                                   has_state_ = false;
+      CallbackManager< void( std::string ) > callback_;
+    };
+  }
+}
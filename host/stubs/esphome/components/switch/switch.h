@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esphome/core/entity_base.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+  namespace switch_ {
+    class Switch : public EntityBase {
+    public:
+      void publish_state( bool state ) {
+        this->state = state;
+        callback_.call( state );
+      }
+
+      void add_on_state_callback( std::function< void( bool ) >&& callback ) { callback_.add( std::move( callback ) ); }
+
+      bool state = false;
+
+    protected:
+      virtual void write_state( bool state ) = 0;
+
+      CallbackManager< void( bool ) > callback_;
+    };
+  }
+}
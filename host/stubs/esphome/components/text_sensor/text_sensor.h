@@ -0,0 +1,26 @@
+#pragma once
+
+#include "esphome/core/entity_base.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+  namespace text_sensor {
+    class TextSensor : public EntityBase {
+    public:
+      void publish_state( const std::string& state ) {
+        this->state      = state;
+        this->has_state_ = true;
+        callback_.call( state );
+      }
+
+      bool has_state() const { return has_state_; }
+      void add_on_state_callback( std::function< void( std::string ) >&& callback ) { callback_.add( std::move( callback ) ); }
+
+      std::string state;
+
+    protected:
+      bool                                   has_state_ = false;
+      CallbackManager< void( std::string ) > callback_;
+    };
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+  namespace uart {
+    class UARTComponent {
+    public:
+      virtual ~UARTComponent() = default;
+
+      virtual void write_array( const uint8_t* data, size_t len ) = 0;
+      virtual bool peek_byte( uint8_t* data )                     = 0;
+      virtual bool read_array( uint8_t* data, size_t len )        = 0;
+      virtual int  available()                                    = 0;
+      virtual void flush()                                        = 0;
+    };
+
+    class UARTDevice {
+    public:
+      UARTDevice() = default;
+      UARTDevice( UARTComponent* parent ) : parent_( parent ) {}
+
+      void set_uart_parent( UARTComponent* parent ) { this->parent_ = parent; }
+
+      void write_byte( uint8_t data ) { this->parent_->write_array( &data, 1 ); }
+      void write_array( const uint8_t* data, size_t len ) { this->parent_->write_array( data, len ); }
+      void write_array( const std::vector< uint8_t >& data ) { this->parent_->write_array( data.data(), data.size() ); }
+
+      bool read_byte( uint8_t* data ) { return this->parent_->read_array( data, 1 ); }
+      bool peek_byte( uint8_t* data ) { return this->parent_->peek_byte( data ); }
+      bool read_array( uint8_t* data, size_t len ) { return this->parent_->read_array( data, len ); }
+      int  available() { return this->parent_->available(); }
+      void flush() { this->parent_->flush(); }
+
+      int read() {
+        uint8_t data;
+        if( !read_byte( &data ) ) {
+          return -1;
+        }
+        return data;
+      }
+
+    protected:
+      UARTComponent* parent_ = nullptr;
+    };
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include "esphome/core/defines.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+  namespace setup_priority {
+    extern const float DATA;
+  }
+
+  class Component {
+  public:
+    virtual ~Component() = default;
+
+    virtual void  setup() {}
+    virtual void  loop() {}
+    virtual void  dump_config() {}
+    virtual void  on_shutdown() {}
+    virtual void  on_safe_shutdown() {}
+    virtual float get_setup_priority() const { return 0.0f; }
+  };
+}
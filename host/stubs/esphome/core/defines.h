@@ -0,0 +1,3 @@
+#pragma once
+
+// Host build: the USE_* feature macros are passed on the compiler command line by CMakeLists.txt.
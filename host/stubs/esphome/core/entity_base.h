@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+  class EntityBase {
+  public:
+    const std::string& get_name() const { return name_; }
+    void               set_name( const std::string& name ) { name_ = name; }
+
+  protected:
+    std::string name_;
+  };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace esphome {
+  std::string format_hex_pretty( const uint8_t* data, size_t length );
+  std::string format_hex_pretty( const std::vector< uint8_t >& data );
+
+  uint32_t random_uint32();
+  float    random_float();
+
+  uint32_t fnv1_hash( const std::string& str );
+
+  // while any requester is started, the main loop runs without its usual delay
+  class HighFrequencyLoopRequester {
+  public:
+    void start() {
+      if( !started_ ) {
+        started_ = true;
+        ++requests();
+      }
+    }
+    void stop() {
+      if( started_ ) {
+        started_ = false;
+        --requests();
+      }
+    }
+    static bool is_high_frequency() { return requests() > 0; }
+
+  protected:
+    static uint32_t& requests() {
+      static uint32_t count = 0;
+      return count;
+    }
+
+    bool started_ = false;
+  };
+
+  template< typename... Ts >
+  class CallbackManager;
+
+  template< typename... Ts >
+  class CallbackManager< void( Ts... ) > {
+  public:
+    void add( std::function< void( Ts... ) >&& callback ) { callbacks_.push_back( std::move( callback ) ); }
+    void call( Ts... args ) {
+      for( auto& cb : callbacks_ ) {
+        cb( args... );
+      }
+    }
+
+  protected:
+    std::vector< std::function< void( Ts... ) > > callbacks_;
+  };
+}
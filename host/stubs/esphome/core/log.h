@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdarg>
+
+#include "esphome/core/defines.h"
+
+#define ESPHOME_LOG_LEVEL_NONE         0
+#define ESPHOME_LOG_LEVEL_ERROR        1
+#define ESPHOME_LOG_LEVEL_WARN         2
+#define ESPHOME_LOG_LEVEL_INFO         3
+#define ESPHOME_LOG_LEVEL_CONFIG       4
+#define ESPHOME_LOG_LEVEL_DEBUG        5
+#define ESPHOME_LOG_LEVEL_VERBOSE      6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+
+// like on the device, the compile time level decides which macros expand to a call (and evaluate their arguments),
+// the runtime level (host_log_level) decides what actually gets printed
+#ifndef ESPHOME_LOG_LEVEL
+  #define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_DEBUG
+#endif
+
+namespace esphome {
+  extern int host_log_level;
+
+  void esp_log_printf_( int level, const char* tag, int line, const char* format, ... ) __attribute__( ( format( printf, 4, 5 ) ) );
+}
+
+#define ESPHOME_HOST_LOG_( level, tag, ... )                        \
+  do {                                                               \
+    if( ESPHOME_LOG_LEVEL >= level ) {                               \
+      ::esphome::esp_log_printf_( level, tag, __LINE__, __VA_ARGS__ ); \
+    }                                                                \
+  } while( 0 )
+
+#define ESP_LOGE( tag, ... )      ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_ERROR, tag, __VA_ARGS__ )
+#define ESP_LOGW( tag, ... )      ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_WARN, tag, __VA_ARGS__ )
+#define ESP_LOGI( tag, ... )      ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_INFO, tag, __VA_ARGS__ )
+#define ESP_LOGCONFIG( tag, ... ) ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_CONFIG, tag, __VA_ARGS__ )
+#define ESP_LOGD( tag, ... )      ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_DEBUG, tag, __VA_ARGS__ )
+#define ESP_LOGV( tag, ... )      ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_VERBOSE, tag, __VA_ARGS__ )
+#define ESP_LOGVV( tag, ... )     ESPHOME_HOST_LOG_( ESPHOME_LOG_LEVEL_VERY_VERBOSE, tag, __VA_ARGS__ )
+
+#define YESNO( b )     ( ( b ) ? "YES" : "NO" )
+#define ONOFF( b )     ( ( b ) ? "ON" : "OFF" )
+#define TRUEFALSE( b ) ( ( b ) ? "TRUE" : "FALSE" )
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace esphome {
+  // In-memory preferences. save() takes effect right away, sync() counts the values that changed since the last sync
+  // like the flash writes of the real backends.
+  class ESPPreferenceObject {
+  public:
+    ESPPreferenceObject() = default;
+    explicit ESPPreferenceObject( std::vector< uint8_t >* data ) : data_( data ) {}
+
+    template< typename T >
+    bool save( const T* src ) {
+      if( data_ == nullptr ) {
+        return false;
+      }
+      data_->assign( reinterpret_cast< const uint8_t* >( src ), reinterpret_cast< const uint8_t* >( src ) + sizeof( T ) );
+      return true;
+    }
+
+    template< typename T >
+    bool load( T* dest ) {
+      if( data_ == nullptr || data_->size() != sizeof( T ) ) {
+        return false;
+      }
+      std::memcpy( dest, data_->data(), sizeof( T ) );
+      return true;
+    }
+
+  private:
+    std::vector< uint8_t >* data_ = nullptr;
+  };
+
+  class ESPPreferences {
+  public:
+    template< typename T >
+    ESPPreferenceObject make_preference( const uint32_t type, const bool in_flash ) {
+      return ESPPreferenceObject( &values_[type] );
+    }
+
+    bool sync();
+
+    // host only: keep the preferences across runs
+    bool load_file( const std::string& path );
+    bool save_file( const std::string& path ) const;
+
+    // values written by sync() since the start
+    uint32_t get_writes() const { return writes_; }
+
+  private:
+    std::map< uint32_t, std::vector< uint8_t > > values_;
+    std::map< uint32_t, std::vector< uint8_t > > synced_;
+    uint32_t                                     writes_ = 0;
+  };
+
+  extern ESPPreferences* global_preferences;
+}
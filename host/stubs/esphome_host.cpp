@@ -0,0 +1,135 @@
+#include "esphome/components/logger/logger.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+namespace esphome {
+  int host_log_level = ESPHOME_LOG_LEVEL_DEBUG;
+
+  namespace logger {
+    static Logger host_logger;
+    Logger*       global_logger = &host_logger;
+  }
+
+  void esp_log_printf_( int level, const char* tag, int line, const char* format, ... ) {
+    if( level > host_log_level ) {
+      return;
+    }
+
+    static const char* const letters = "-EWICDVV";
+    std::fprintf( stderr, "[%c][%s:%03d]: ", letters[level], tag, line );
+
+    va_list args;
+    va_start( args, format );
+    std::vfprintf( stderr, format, args );
+    va_end( args );
+
+    std::fputc( '\n', stderr );
+  }
+
+  namespace setup_priority {
+    const float DATA = 600.0f;
+  }
+
+  static const auto start_time = std::chrono::steady_clock::now();
+
+  uint32_t millis() {
+    return std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::steady_clock::now() - start_time ).count();
+  }
+
+  uint32_t micros() {
+    return std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start_time ).count();
+  }
+
+  void delay( uint32_t ms ) { std::this_thread::sleep_for( std::chrono::milliseconds( ms ) ); }
+  void delayMicroseconds( uint32_t us ) { std::this_thread::sleep_for( std::chrono::microseconds( us ) ); }
+
+  std::string format_hex_pretty( const uint8_t* data, size_t length ) {
+    if( length == 0 ) {
+      return "";
+    }
+
+    std::string ret;
+    char        str[4];
+    for( size_t i = 0; i < length; i++ ) {
+      std::snprintf( str, sizeof( str ), i ? ".%02X" : "%02X", data[i] );
+      ret += str;
+    }
+    if( length > 4 ) {
+      ret += " (" + std::to_string( length ) + ")";
+    }
+    return ret;
+  }
+
+  std::string format_hex_pretty( const std::vector< uint8_t >& data ) { return format_hex_pretty( data.data(), data.size() ); }
+
+  uint32_t random_uint32() {
+    static std::mt19937 rng( std::random_device {}() );
+    return rng();
+  }
+
+  float random_float() { return random_uint32() / float( UINT32_MAX ); }
+
+  uint32_t fnv1_hash( const std::string& str ) {
+    uint32_t hash = 2166136261UL;
+    for( char c : str ) {
+      hash *= 16777619UL;
+      hash ^= c;
+    }
+    return hash;
+  }
+
+  static ESPPreferences host_preferences;
+  ESPPreferences*       global_preferences = &host_preferences;
+
+  bool ESPPreferences::sync() {
+    for( const auto& value : values_ ) {
+      auto synced = synced_.find( value.first );
+      if( synced == synced_.end() || synced->second != value.second ) {
+        synced_[value.first] = value.second;
+        ++writes_;
+      }
+    }
+    return true;
+  }
+
+  // one record per value: type, size and the bytes
+  bool ESPPreferences::load_file( const std::string& path ) {
+    FILE* in = std::fopen( path.c_str(), "rb" );
+    if( in == nullptr ) {
+      return false;
+    }
+    uint32_t header[2];
+    while( std::fread( header, sizeof( header ), 1, in ) == 1 ) {
+      std::vector< uint8_t > data( header[1] );
+      if( std::fread( data.data(), 1, data.size(), in ) != data.size() ) {
+        break;
+      }
+      values_[header[0]] = data;
+      synced_[header[0]] = data;
+    }
+    std::fclose( in );
+    return true;
+  }
+
+  bool ESPPreferences::save_file( const std::string& path ) const {
+    FILE* out = std::fopen( path.c_str(), "wb" );
+    if( out == nullptr ) {
+      return false;
+    }
+    bool ok = true;
+    for( const auto& value : synced_ ) {
+      const uint32_t header[2] = { value.first, ( uint32_t )value.second.size() };
+      ok = ok && std::fwrite( header, sizeof( header ), 1, out ) == 1 &&
+           std::fwrite( value.second.data(), 1, value.second.size(), out ) == value.second.size();
+    }
+    return std::fclose( out ) == 0 && ok;
+  }
+}
@@ -0,0 +1,295 @@
+// Tests of the helpers of the BSB component that can go wrong without anything on the bus noticing: the time program
+// parsers and formatter, the lookup of options by text, the heaps of the scheduler, the receive queue and the
+// histogram buckets. Run by ctest, prints the failed checks and exits with 1 if there are any.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bsbMetrics.h"
+#include "bsbOptions.h"
+#include "bsbReceiveTask.h"
+#include "bsbScheduler.h"
+#include "bsbTimeProgram.h"
+
+using namespace esphome::bsb;
+
+namespace {
+  int failures = 0;
+
+#define CHECK( condition )                                                                                                                 \
+  do {                                                                                                                                     \
+    if( !( condition ) ) {                                                                                                                 \
+      std::fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition );                                                 \
+      ++failures;                                                                                                                          \
+    }                                                                                                                                      \
+  } while( 0 )
+
+  // time programs
+
+  bool parses( const char* text ) {
+    uint8_t week[TimeProgramDays][TimeProgramDayBytes];
+    return parse_time_program( text, week );
+  }
+
+  // the text formatted from what text parses to, empty if it does not parse
+  std::string round_trip( const char* text ) {
+    uint8_t week[TimeProgramDays][TimeProgramDayBytes];
+    return parse_time_program( text, week ) ? format_time_program( week ) : std::string();
+  }
+
+  void test_time_program() {
+    const char* week = "06:00-08:00 17:00-22:00;06:00-22:00;;00:00-24:00;05:30-07:45 12:00-13:00 18:15-23:59;;08:00-09:00";
+    CHECK( round_trip( week ) == week );
+    CHECK( round_trip( ";;;;;;" ) == ";;;;;;" );
+    // separators and missing leading zeros are normalized
+    CHECK( round_trip( "6:00-8:00,17:00-22:00;;;;;;" ) == "06:00-08:00 17:00-22:00;;;;;;" );
+
+    uint8_t days[TimeProgramDays][TimeProgramDayBytes];
+    CHECK( parse_time_program( "06:00-08:00;;;;;;", days ) );
+    const uint8_t monday[TimeProgramDayBytes] = {
+      6, 0, 8, 0, TimeProgramUnused, 0, TimeProgramUnused, 0, TimeProgramUnused, 0, TimeProgramUnused, 0 };
+    CHECK( std::memcmp( days[0], monday, sizeof( monday ) ) == 0 );
+    CHECK( days[6][0] == TimeProgramUnused && days[6][2] == TimeProgramUnused );
+
+    // a phase may end at midnight, not after it
+    CHECK( round_trip( "23:00-24:00;;;;;;" ) == "23:00-24:00;;;;;;" );
+    CHECK( !parses( "23:00-24:01;;;;;;" ) );
+    CHECK( !parses( "24:00-24:00;;;;;;" ) );
+    // four phases
+    CHECK( !parses( "01:00-02:00 03:00-04:00 05:00-06:00 07:00-08:00;;;;;;" ) );
+    // ending before or when it starts
+    CHECK( !parses( "08:00-07:00;;;;;;" ) );
+    CHECK( !parses( "08:00-08:00;;;;;;" ) );
+    CHECK( !parses( "08:60-09:00;;;;;;" ) );
+    // missing ';', six or eight days, anything else after a phase
+    CHECK( !parses( "06:00-08:00 ;;;;;" ) );
+    CHECK( !parses( "06:00-08:00 17:00-22:00;;;;;" ) );
+    CHECK( !parses( ";;;;;;;" ) );
+    CHECK( !parses( "06:00-08:00x;;;;;;" ) );
+    CHECK( !parses( "06:00;;;;;;" ) );
+  }
+
+  // options
+
+  void test_options() {
+    // sorted by value, and their indices sorted by text
+    const BsbOption options[]   = { { -1, "Off" }, { 0, "Auto" }, { 1, "Comfort" }, { 3, "Reduced" }, { 4, "Frost" } };
+    const uint8_t   by_option[] = { 1, 2, 4, 0, 3 };
+
+    BsbOptionTable table;
+    CHECK( table.empty() );
+    table.set( options, by_option, 5 );
+    CHECK( table.size() == 5 );
+
+    for( const BsbOption& option : options ) {
+      int8_t value = 100;
+      CHECK( table.find_value( option.option, value ) && value == option.value );
+      CHECK( table.find_option( option.value ) != nullptr && std::strcmp( table.find_option( option.value ), option.option ) == 0 );
+    }
+
+    int8_t value = 100;
+    CHECK( !table.find_value( "", value ) );
+    CHECK( !table.find_value( "A", value ) );
+    CHECK( !table.find_value( "Comf", value ) );
+    CHECK( !table.find_value( "Comfortable", value ) );
+    CHECK( !table.find_value( "off", value ) );
+    CHECK( !table.find_value( "Zzz", value ) );
+    CHECK( value == 100 );
+    CHECK( table.find_option( 2 ) == nullptr );
+    CHECK( table.find_option( -2 ) == nullptr );
+    CHECK( table.find_option( 5 ) == nullptr );
+
+    // without the index by text only lookups by value work
+    table.set( options, nullptr, 5 );
+    CHECK( !table.find_value( "Auto", value ) );
+    CHECK( table.find_option( 0 ) != nullptr );
+  }
+
+  // scheduler
+
+  class TestItem : public BsbSchedulerItem {
+  public:
+    using BsbSchedulerItem::set_due;
+  };
+
+  class TestScheduler : public BsbScheduler {
+  public:
+    // both heaps are ordered by their key
+    bool is_valid() const { return is_heap( waiting_ ) && is_heap( released_ ); }
+
+    size_t waiting() const { return waiting_.size(); }
+
+  protected:
+    static bool is_heap( const Heap& heap ) {
+      for( size_t i = 0; i < heap.size(); i++ ) {
+        if( i > 0 && key( heap, ( i - 1 ) / 2 ) > key( heap, i ) ) {
+          return false;
+        }
+      }
+      return true;
+    }
+  };
+
+  size_t due_by( const std::vector< TestItem >& items, const uint32_t now ) {
+    size_t due = 0;
+    for( const TestItem& item : items ) {
+      due += item.get_due() <= now;
+    }
+    return due;
+  }
+
+  // top is due, and no item that is due has an earlier deadline
+  bool is_earliest_deadline( const BsbSchedulerItem* top, const std::vector< TestItem >& items, const uint32_t now ) {
+    if( top == nullptr || top->get_due() > now ) {
+      return false;
+    }
+    for( const TestItem& item : items ) {
+      if( item.get_due() <= now && item.get_deadline() < top->get_deadline() ) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void test_scheduler() {
+    TestScheduler           scheduler;
+    std::vector< TestItem > items( 20 );
+    for( size_t i = 0; i < items.size(); i++ ) {
+      // due times in an order unlike the order of the items, and slacks that make the deadlines cross the due times
+      items[i].set_due( ( i * 7 ) % 20 * 100, ( i % 4 ) * 250 );
+      scheduler.add( &items[i] );
+      CHECK( scheduler.is_valid() );
+    }
+    CHECK( scheduler.size() == items.size() );
+    CHECK( scheduler.top() == nullptr );
+
+    // moving waiting items in both directions
+    items[3].set_due( 50, 0 );
+    CHECK( scheduler.is_valid() );
+    items[0].set_due( 5000, 1000 );
+    CHECK( scheduler.is_valid() );
+
+    scheduler.release( 1000 );
+    CHECK( scheduler.is_valid() );
+    CHECK( scheduler.size() - scheduler.waiting() == due_by( items, 1000 ) );
+    CHECK( is_earliest_deadline( scheduler.top(), items, 1000 ) );
+
+    // a released item moved to later waits again, one moved earlier stays in place until the next release
+    items[3].set_due( 3000, 0 );
+    CHECK( scheduler.is_valid() );
+    CHECK( scheduler.top() != &items[3] );
+    items[19].set_due( 0, 0 );
+    CHECK( scheduler.is_valid() );
+    scheduler.release( 1000 );
+    CHECK( scheduler.is_valid() );
+    CHECK( scheduler.top() == &items[19] );
+
+    // sending items in order: each one is moved to its next due time, like a poll after its answer
+    for( uint32_t now = 1000; now < 4000; now += 10 ) {
+      scheduler.release( now );
+      CHECK( scheduler.is_valid() );
+      CHECK( scheduler.size() - scheduler.waiting() == due_by( items, now ) );
+      TestItem* item = static_cast< TestItem* >( scheduler.top() );
+      if( item == nullptr ) {
+        continue;
+      }
+      CHECK( is_earliest_deadline( item, items, now ) );
+      item->set_due( now + 2000, 500 );
+      CHECK( scheduler.is_valid() );
+    }
+    CHECK( scheduler.size() == items.size() );
+
+    // due times near the end of the clock do not wrap the deadline
+    items[5].set_due( BsbSchedulerItem::Never - 10, 100 );
+    CHECK( items[5].get_deadline() == BsbSchedulerItem::Never );
+    CHECK( scheduler.is_valid() );
+  }
+
+  // receive queue
+
+  void test_spsc_queue() {
+    BsbSpscQueue< int, 4 > queue;
+    CHECK( queue.front() == nullptr );
+
+    // around the end of the ring a few times
+    int next_push = 0;
+    int next_pop  = 0;
+    for( int round = 0; round < 5; round++ ) {
+      while( int* slot = queue.back() ) {
+        *slot = next_push++;
+        queue.push();
+      }
+      CHECK( next_push - next_pop == 4 );
+      CHECK( queue.back() == nullptr );
+
+      for( int i = 0; i < 3; i++ ) {
+        const int* item = queue.front();
+        CHECK( item != nullptr && *item == next_pop );
+        queue.pop();
+        ++next_pop;
+      }
+    }
+    while( const int* item = queue.front() ) {
+      CHECK( *item == next_pop++ );
+      queue.pop();
+    }
+    CHECK( next_pop == next_push );
+    CHECK( queue.back() != nullptr );
+  }
+
+  // histogram
+
+  class TestHistogram : public BsbHistogram {
+  public:
+    using BsbHistogram::bucket;
+    using BsbHistogram::upper_bound;
+  };
+
+  void test_histogram() {
+    // every value is in a bucket whose upper bound is at least the value and less than 25% above it, the bounds grow
+    // with the buckets, and a bucket starts right after the previous one ends
+    for( uint32_t value = 0; value < 1u << 16; value++ ) {
+      const uint8_t  bucket = TestHistogram::bucket( value );
+      const uint32_t upper  = TestHistogram::upper_bound( bucket );
+      CHECK( value <= upper );
+      CHECK( upper - value <= value / 4 );
+      if( bucket > 0 ) {
+        CHECK( TestHistogram::upper_bound( bucket - 1 ) < value );
+      }
+    }
+    for( uint8_t bucket = 1; bucket < BsbHistogram::Buckets; bucket++ ) {
+      CHECK( TestHistogram::upper_bound( bucket ) > TestHistogram::upper_bound( bucket - 1 ) );
+      CHECK( TestHistogram::bucket( TestHistogram::upper_bound( bucket ) ) == bucket );
+    }
+    CHECK( TestHistogram::bucket( UINT32_MAX ) == BsbHistogram::Buckets - 1 );
+
+    BsbHistogram histogram;
+    CHECK( histogram.percentile( 0.5f ) == 0 );
+    for( uint32_t value = 1; value <= 100; value++ ) {
+      histogram.add( value );
+    }
+    CHECK( histogram.count() == 100 && histogram.max() == 100 );
+    CHECK( histogram.percentile( 0.5f ) >= 50 && histogram.percentile( 0.5f ) <= 50 * 5 / 4 );
+    CHECK( histogram.percentile( 1.0f ) == 100 );
+    histogram.clear();
+    CHECK( histogram.count() == 0 && histogram.percentile( 0.9f ) == 0 );
+  }
+} // namespace
+
+int main() {
+  test_time_program();
+  test_options();
+  test_scheduler();
+  test_spsc_queue();
+  test_histogram();
+
+  if( failures != 0 ) {
+    std::fprintf( stderr, "%d checks failed\n", failures );
+    return 1;
+  }
+  std::printf( "all checks passed\n" );
+  return 0;
+}